@@ -0,0 +1,87 @@
+#include "socketstream.hh"
+#include <iostream>
+#include <string>
+using namespace std;
+
+typedef swoope::socket_reactor reactor_type;
+
+class connection : public reactor_type::handler {
+public:
+	explicit connection(reactor_type& r) : reactor(r), buf(), line()
+	{
+	}
+
+	swoope::socketbuf& socketbuf()
+	{
+		return buf;
+	}
+
+	/* Echoes every complete line, without waiting for the client */
+	void ready(swoope::socketbuf& sb, int)
+	{
+		char_traits<char>::int_type c;
+		bool echoed(true);
+
+		while (echoed != false &&
+			(c = sb.sbumpc()) != char_traits<char>::eof()) {
+			line += char_traits<char>::to_char_type(c);
+			if (line[line.size() - 1] != '\n') continue;
+			cout << sb.remote_address() << ": " << line << flush;
+			/* A client that does not read its echoes is dropped */
+			echoed = sb.sputn(line.data(), line.size()) ==
+					static_cast<streamsize>(line.size());
+			line.clear();
+		}
+		/* Output the client is not ready for waits for writable */
+		if (echoed != false && sb.would_block() != false &&
+						sb.pubsync() == 0)
+			return;
+		cout << "Connection from " << sb.remote_address() <<
+							" closed" << endl;
+		reactor.remove(sb);
+		sb.close();
+		delete this;
+	}
+private:
+	reactor_type& reactor;
+	swoope::socketbuf buf;
+	string line;
+};
+
+class listener : public reactor_type::handler {
+public:
+	explicit listener(reactor_type& r) : reactor(r)
+	{
+	}
+
+	/* Accepts every pending connection */
+	void ready(swoope::socketbuf& sb, int)
+	{
+		connection* c(new connection(reactor));
+
+		while (sb.accept(c->socketbuf()) != 0) {
+			cout << "Connection from " <<
+				c->socketbuf().remote_address() << endl;
+			reactor.add(c->socketbuf(), *c, reactor_type::readable |
+						reactor_type::writable);
+			c = new connection(reactor);
+		}
+		delete c;
+	}
+private:
+	reactor_type& reactor;
+};
+
+int main(int argc, char* argv[])
+{
+	reactor_type reactor;
+	swoope::socketbuf server;
+	listener l(reactor);
+
+	if (argc != 2) return 1;
+	if (reactor.is_open() == false || server.open(argv[1], 64) == 0 ||
+				reactor.add(server, l) == 0)
+		return 1;
+	reactor.run();
+	return 0;
+}
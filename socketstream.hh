@@ -6,17 +6,75 @@
 #include "src/native_socket_traits.hh"
 #include "src/basic_socketbuf.hh"
 #include "src/basic_socketstream.hh"
+#include "src/basic_socket_relay.hh"
+#include "src/basic_datagram_socket.hh"
+#include "src/timing_wheel.hh"
+#if defined(__linux__)
+#include "src/basic_socket_reactor.hh"
+#endif
+#if defined(__linux__) || \
+	defined(__APPLE__) || \
+	defined(_XOPEN_SOURCE)
+#include "src/detail/unix_socket_traits.hh"
+#endif
+#if defined(SWOOPE_WITH_OPENSSL) && \
+	(defined(__linux__) || \
+	defined(__APPLE__) || \
+	defined(_XOPEN_SOURCE))
+#include "src/detail/openssl_socket_traits.hh"
+#endif
+#if defined(SWOOPE_WITH_IO_URING) && \
+	defined(__linux__) && __cplusplus >= 201103L
+#include "src/detail/io_uring_socket_traits.hh"
+#endif
+#if defined(__linux__) && __cplusplus >= 201103L
+#include "src/basic_socket_acceptor.hh"
+#endif
+#if __cplusplus >= 201103L
+#include "src/basic_socket_pool.hh"
+#include "src/resolver_cache.hh"
+#include "src/socketbuf_pool.hh"
+#endif
 
 namespace swoope {
 
 	typedef basic_socketbuf<native_socket_traits> socketbuf;
 	typedef basic_socketstream<native_socket_traits> socketstream;
-
-	/*
-	 * TODO: Make interface to an SSL socket library
-	 *
-	 * typedef basic_socketstream<openssl_socket_traits> openssl_socketstream;
-	 */
+	typedef basic_socket_relay<native_socket_traits> socket_relay;
+	typedef basic_datagram_socket<native_socket_traits> datagram_socket;
+#if __cplusplus >= 201103L
+	typedef basic_socket_pool<native_socket_traits> socket_pool;
+#endif
+#if defined(__linux__)
+	typedef basic_socket_reactor<native_socket_traits> socket_reactor;
+#endif
+#if defined(__linux__) || \
+	defined(__APPLE__) || \
+	defined(_XOPEN_SOURCE)
+	typedef basic_socketbuf<unix_socket_traits> unix_socketbuf;
+	typedef basic_socketstream<unix_socket_traits> unix_socketstream;
+	typedef basic_socketbuf<unix_seqpacket_socket_traits>
+						unix_seqpacket_socketbuf;
+	typedef basic_socketstream<unix_seqpacket_socket_traits>
+						unix_seqpacket_socketstream;
+#endif
+#if defined(SWOOPE_WITH_IO_URING) && \
+	defined(__linux__) && __cplusplus >= 201103L
+	typedef basic_socketbuf<io_uring_socket_traits> io_uring_socketbuf;
+	typedef basic_socketstream<io_uring_socket_traits>
+						io_uring_socketstream;
+#endif
+#if defined(__linux__) && __cplusplus >= 201103L
+	typedef basic_socket_acceptor<native_socket_traits> socket_acceptor;
+#endif
+#if defined(SWOOPE_WITH_OPENSSL) && \
+	(defined(__linux__) || \
+	defined(__APPLE__) || \
+	defined(_XOPEN_SOURCE))
+	typedef basic_socketbuf<openssl_socket_traits> openssl_socketbuf;
+	typedef basic_socketstream<openssl_socket_traits>
+						openssl_socketstream;
+#endif
 }
 
 #endif
@@ -0,0 +1,106 @@
+#ifndef SWOOPE_BASIC_DATAGRAM_SOCKET_HH
+#define SWOOPE_BASIC_DATAGRAM_SOCKET_HH
+
+/*
+ * basic_datagram_socket.hh
+ */
+
+#include <cstddef>
+#include <string>
+#include "datagram.hh"
+#include "socket_option.hh"
+#include "socketbuf_allocator.hh"
+
+namespace swoope {
+
+	/*
+	 * A UDP socket that sends and receives messages in batches, up to
+	 * SocketTraits::datagram_batch per system call, either into buffers
+	 * the caller provides or into a set of receive buffers it keeps. With
+	 * segmentation offload one datagram can carry many packets of equal
+	 * size each way.
+	 */
+	template <class SocketTraits>
+	class basic_datagram_socket {
+	public:
+		typedef SocketTraits socket_traits_type;
+		typedef typename socket_traits_type::socket_type socket_type;
+
+		basic_datagram_socket();
+		virtual ~basic_datagram_socket();
+		/*
+		 * Opens a socket connected to host and service, so that
+		 * datagrams without a peer go there and only datagrams from
+		 * there are received. Returns this on success.
+		 */
+		basic_datagram_socket* open(const std::string& host,
+					const std::string& service);
+		/*
+		 * Opens a socket bound to service on the local host, to receive
+		 * from and send to any peer. Returns this on success.
+		 */
+		basic_datagram_socket* open(const std::string& service);
+		/* Closes the socket. Returns this on success. */
+		basic_datagram_socket* close();
+		bool is_open() const;
+		socket_type socket() const;
+		basic_datagram_socket* set_blocking(bool blocking);
+		/*
+		 * Returns true if the last send or receive stopped because the
+		 * non-blocking socket was not ready.
+		 */
+		bool would_block() const;
+		basic_datagram_socket* set_option(const socket_option& option);
+		/*
+		 * Lets the kernel hand consecutive packets of one flow over as a
+		 * single datagram, with segment_size set to the packet size
+		 * (UDP GRO, Linux). Receive buffers must then be large enough
+		 * for a coalesced datagram, 64 KiB at most. Returns this on
+		 * success.
+		 */
+		basic_datagram_socket* set_gro(bool on);
+		/*
+		 * Sends count datagrams in order, batch by batch. Returns how
+		 * many were sent; fewer than count means an error or, on a
+		 * non-blocking socket, a full send buffer stopped the rest.
+		 */
+		std::size_t send(const datagram* d, std::size_t count);
+		/*
+		 * Receives up to count datagrams into the buffers of d, setting
+		 * the size, peer, segment size and truncation of each. A blocking
+		 * socket waits for the first datagram only, then takes what else
+		 * is queued. Returns how many were received, 0 on error.
+		 */
+		std::size_t receive(datagram* d, std::size_t count);
+		/*
+		 * Keeps count receive buffers of size bytes each, taken one by
+		 * one from a, or from the free store if a is 0, for receive()
+		 * without arguments. Returns this on success.
+		 */
+		basic_datagram_socket* set_receive_buffers(std::size_t count,
+					std::size_t size,
+					socketbuf_allocator* a = 0);
+		/*
+		 * Receives into the kept buffers, overwriting what the last call
+		 * received, and returns how many datagrams arrived.
+		 */
+		std::size_t receive();
+		/* Returns the kept buffers, filled by the last receive(). */
+		const datagram* received() const;
+	private:
+		basic_datagram_socket(const basic_datagram_socket&);
+		basic_datagram_socket& operator=(const basic_datagram_socket&);
+		void free_buffers();
+
+		socket_type sock;
+		datagram* buffers;
+		std::size_t buffer_count, buffer_size;
+		socketbuf_allocator* allocator;
+		bool blocked;
+	};
+
+}
+
+#include "impl/basic_datagram_socket.cc"
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SWOOPE_BASIC_SOCKET_ACCEPTOR_HH
+#define SWOOPE_BASIC_SOCKET_ACCEPTOR_HH
+
+/*
+ * basic_socket_acceptor.hh
+ */
+
+#include "basic_socketbuf.hh"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+namespace swoope {
+
+	/*
+	 * Accepts connections on one port with a group of SO_REUSEPORT
+	 * listeners, each served by its own thread, so that the kernel spreads
+	 * incoming connections over several accept queues instead of one.
+	 */
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
+	class basic_socket_acceptor {
+	public:
+		typedef basic_socketbuf<SocketTraits, BufferPolicy>
+							socketbuf_type;
+
+		class handler {
+		public:
+			virtual ~handler() {}
+			/*
+			 * Called on the thread of listener index for every
+			 * connection it accepts. sb may be moved from; if it is
+			 * still open when the handler returns, it is closed by
+			 * the next accept.
+			 */
+			virtual void accepted(socketbuf_type& sb,
+						std::size_t index) = 0;
+		};
+
+		basic_socket_acceptor();
+		virtual ~basic_socket_acceptor();
+		bool is_open() const;
+		/*
+		 * Opens count listeners on service, one per CPU if count is 0.
+		 * Every listener gets SO_REUSEPORT and prefers connections
+		 * received on the CPU of its own index through SO_INCOMING_CPU.
+		 * options.steer_by_cpu additionally makes the kernel hand each
+		 * connection to the listener of that CPU. Returns this on
+		 * success.
+		 */
+		basic_socket_acceptor* open(const std::string& service,
+				int backlog, std::size_t count = 0,
+				const listener_options& options =
+						listener_options());
+		/* Returns the number of listeners. */
+		std::size_t size() const;
+		/*
+		 * Returns listener index, for example to give it an allocator
+		 * that the connections it accepts inherit.
+		 */
+		socketbuf_type& listener(std::size_t index);
+		/*
+		 * Starts one thread per listener that accepts connections and
+		 * passes them to h. If pin is true, the thread of listener i is
+		 * bound to CPU i. Returns this on success.
+		 */
+		basic_socket_acceptor* start(handler& h, bool pin = true);
+		/*
+		 * Stops the threads, waiting for running handlers to return, and
+		 * closes the listeners.
+		 */
+		void close();
+	private:
+		basic_socket_acceptor(const basic_socket_acceptor&) = delete;
+		basic_socket_acceptor& operator=(
+				const basic_socket_acceptor&) = delete;
+		void serve(std::size_t index, handler* h, bool pin);
+
+		std::vector<socketbuf_type*> listeners;
+		std::vector<std::thread> threads;
+		std::atomic<bool> stopping;
+	};
+
+}
+
+#include "impl/basic_socket_acceptor.cc"
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SWOOPE_BASIC_SOCKET_POOL_HH
+#define SWOOPE_BASIC_SOCKET_POOL_HH
+
+/*
+ * basic_socket_pool.hh
+ */
+
+#include "basic_socketstream.hh"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace swoope {
+
+	/*
+	 * Thread-safe pool of connected socketstreams, keyed by host and
+	 * service, that lets requests to the same peer reuse a connection
+	 * instead of resolving and connecting again.
+	 */
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
+	class basic_socket_pool {
+	public:
+		typedef basic_socketstream<SocketTraits, BufferPolicy>
+							stream_type;
+		typedef SocketTraits socket_traits_type;
+		typedef typename socket_traits_type::socket_type socket_type;
+		typedef std::chrono::steady_clock clock_type;
+
+		/*
+		 * Creates a pool that keeps at most max_per_key connections, in
+		 * use or idle, to each host and service, and closes connections
+		 * that have been idle for idle_timeout. New connections are made
+		 * with options.
+		 */
+		explicit basic_socket_pool(std::size_t max_per_key = 8,
+				clock_type::duration idle_timeout =
+						std::chrono::seconds(60),
+				const connect_options& options =
+						connect_options());
+		virtual ~basic_socket_pool();
+		/*
+		 * Moves an idle connection to host and service into s, after
+		 * checking that the peer has not closed it, or connects a new
+		 * one. Returns false, leaving s closed, if the key has
+		 * max_per_key connections already or the connect fails.
+		 */
+		bool acquire(const std::string& host,
+				const std::string& service, stream_type& s);
+		/*
+		 * Gives back a connection acquired for host and service. It is
+		 * kept for reuse if the stream is good, its output can be
+		 * flushed, and no input is left unread. Otherwise it is closed.
+		 * Either way s is left closed.
+		 */
+		void release(const std::string& host,
+				const std::string& service, stream_type& s);
+		/*
+		 * Closes connections that have been idle for idle_timeout and
+		 * returns how many were closed.
+		 */
+		std::size_t purge();
+		/* Returns the number of idle connections. */
+		std::size_t idle() const;
+		/* Returns the number of connections in use or idle. */
+		std::size_t size() const;
+	private:
+		typedef std::pair<std::string, std::string> key_type;
+
+		struct connection {
+			stream_type stream;
+			clock_type::time_point since;
+		};
+
+		struct bucket {
+			std::deque<connection> idle;
+			std::size_t open;
+
+			bucket() :
+			idle(),
+			open(0)
+			{
+			}
+		};
+
+		typedef std::map<key_type, bucket> bucket_map;
+
+		basic_socket_pool(const basic_socket_pool&) = delete;
+		basic_socket_pool& operator=(const basic_socket_pool&) = delete;
+		static bool alive(stream_type& s);
+		void forget(const key_type& key);
+
+		const std::size_t max_per_key;
+		const clock_type::duration idle_timeout;
+		const connect_options options;
+		bucket_map buckets;
+		mutable std::mutex lock;
+	};
+
+}
+
+#include "impl/basic_socket_pool.cc"
+
+#endif
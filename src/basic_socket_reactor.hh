@@ -0,0 +1,115 @@
+#ifndef SWOOPE_BASIC_SOCKET_REACTOR_HH
+#define SWOOPE_BASIC_SOCKET_REACTOR_HH
+
+/*
+ * basic_socket_reactor.hh
+ */
+
+#include "basic_socketbuf.hh"
+#include "detail/epoll_poller.hh"
+#include "timing_wheel.hh"
+#include <map>
+#include <vector>
+
+namespace swoope {
+
+	/*
+	 * Dispatches edge-triggered readiness events for many non-blocking
+	 * socketbufs, connected or listening, from a single thread.
+	 */
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
+	class basic_socket_reactor {
+	public:
+		typedef basic_socketbuf<SocketTraits, BufferPolicy>
+							socketbuf_type;
+		typedef epoll_poller poller_type;
+
+		enum {
+			readable = poller_type::readable,
+			writable = poller_type::writable,
+			closed = poller_type::closed
+		};
+
+		class handler {
+		public:
+			virtual ~handler() {}
+			/*
+			 * Called when sb becomes ready. events is a combination of
+			 * readable, writable and closed. Notification is
+			 * edge-triggered, so the handler should read, write or
+			 * accept until sb.would_block() before returning.
+			 */
+			virtual void ready(socketbuf_type& sb, int events) = 0;
+		};
+
+		basic_socket_reactor();
+		virtual ~basic_socket_reactor();
+		bool is_open() const;
+		/*
+		 * Puts sb into non-blocking mode and registers it so that h is
+		 * called when any of events occur. sb must stay at the same
+		 * address until it is removed. Registering sb again replaces its
+		 * handler and events. Returns this on success.
+		 */
+		basic_socket_reactor* add(socketbuf_type& sb, handler& h,
+						int events = readable);
+		/* Changes the events sb is registered for. Returns this on success. */
+		basic_socket_reactor* modify(socketbuf_type& sb, int events);
+		/*
+		 * Unregisters sb. May be called from a handler, also for other
+		 * socketbufs. Returns this on success.
+		 */
+		basic_socket_reactor* remove(socketbuf_type& sb);
+		/* Returns the number of registered socketbufs. */
+		std::size_t size() const;
+		/*
+		 * Returns the reactor's timers, which tick once per millisecond,
+		 * for idle, read and write time limits of its connections. Their
+		 * expire() runs on the reactor's thread like the handlers, and
+		 * delays count from the reactor's last round.
+		 */
+		timing_wheel& timers();
+		/*
+		 * Waits up to timeout milliseconds (-1 for no limit), or until
+		 * the next timer may be due, runs the handlers of every ready
+		 * socketbuf and expires the timers that are due. Returns the
+		 * number of events dispatched and timers expired, or -1 on
+		 * error.
+		 */
+		int run_once(int timeout = -1);
+		/*
+		 * Runs handlers and timers until stop() is called or nothing is
+		 * registered or armed.
+		 */
+		void run();
+		/* Makes run() return after the current round of handlers. */
+		void stop();
+	private:
+		struct registration {
+			socketbuf_type* sb;
+			handler* h;
+		};
+
+		typedef std::map<socketbuf_type*, registration*> registry_type;
+
+		basic_socket_reactor(const basic_socket_reactor&);
+		basic_socket_reactor& operator=(const basic_socket_reactor&);
+		void retire(registration* r);
+		void purge();
+		std::size_t expire_timers();
+
+		typename poller_type::handle_type poller;
+		registry_type registry;
+		std::vector<registration*> retired;
+		bool stopped;
+		timing_wheel wheel;
+
+		/* Millisecond at which the wheel was last advanced */
+		long last_tick;
+	};
+
+}
+
+#include "impl/basic_socket_reactor.cc"
+
+#endif
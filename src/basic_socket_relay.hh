@@ -0,0 +1,62 @@
+#ifndef SWOOPE_BASIC_SOCKET_RELAY_HH
+#define SWOOPE_BASIC_SOCKET_RELAY_HH
+
+/*
+ * basic_socket_relay.hh
+ */
+
+#include "basic_socketbuf.hh"
+
+namespace swoope {
+
+	/*
+	 * Forwards bytes between blocking socketbufs inside the kernel, without
+	 * passing them through either socketbuf's buffers.
+	 */
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
+	class basic_socket_relay {
+	public:
+		typedef basic_socketbuf<SocketTraits, BufferPolicy>
+							socketbuf_type;
+		typedef SocketTraits socket_traits_type;
+		typedef typename socket_traits_type::socket_type socket_type;
+
+		basic_socket_relay();
+		virtual ~basic_socket_relay();
+		/*
+		 * Forwards input from src to dst until src reaches end of stream,
+		 * then shuts dst down for output. Input already buffered by src is
+		 * sent first. Returns the number of bytes forwarded, or -1 if an
+		 * error stopped the transfer. Bytes taken from src but not yet
+		 * sent when an error stops the transfer are kept, and sent first
+		 * by the next call for the same direction; Winsock, which has no
+		 * pipe to keep them in, loses them.
+		 */
+		std::streamsize forward(socketbuf_type& src, socketbuf_type& dst);
+		/*
+		 * Forwards in both directions between a and b until both have
+		 * reached end of stream. The end of each direction is passed on
+		 * as a shutdown for output of the other socketbuf. Returns this on
+		 * success.
+		 */
+		basic_socket_relay* run(socketbuf_type& a, socketbuf_type& b);
+	private:
+		basic_socket_relay(const basic_socket_relay&);
+		basic_socket_relay& operator=(const basic_socket_relay&);
+		std::streamsize drain(socketbuf_type& src,
+						socketbuf_type& dst);
+		std::streamsize step(socketbuf_type& src, socketbuf_type& dst,
+								int i);
+
+		/* Pipes that splice stages data in, one per direction */
+		int pipes[2][2];
+
+		/* Bytes left in each pipe by a transfer that failed */
+		std::streamsize staged[2];
+	};
+
+}
+
+#include "impl/basic_socket_relay.cc"
+
+#endif
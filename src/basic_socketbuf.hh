@@ -12,15 +12,36 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <vector>
+#include <sys/types.h>
+#include "connect_options.hh"
+#include "endpoint.hh"
+#include "socketbuf_allocator.hh"
+#include "listener_options.hh"
+#include "socket_option.hh"
+#include "buffer_policy.hh"
 
 namespace swoope {
 
-	template <class SocketTraits>
-	class basic_socketbuf_base {
+	/* When sync(), which std::flush and std::endl call, sends output */
+	enum flush_policy {
+		flush_immediate, /* at every sync, the default */
+		flush_explicit, /* only at push() or when the put area fills */
+		flush_coalesce /* corked until output has waited the delay */
+	};
+
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
+	class basic_socketbuf_base :
+	public BufferPolicy {
 	public:
 		/* Socket handle */
 		typename SocketTraits::socket_type socket;
 
+		/* Addresses of both ends, looked up at most once */
+		mutable endpoint local_ep, remote_ep;
+		mutable bool local_known, remote_known;
+
 		/* Buffer used for unbuffered I/O */
 		char buf[1];
 
@@ -29,12 +50,65 @@ namespace swoope {
 
 		std::streamsize
 			gasize, /* get area size */
-			pasize; /* put area size */
+			pasize, /* put area size */
+			gamax; /* get area growth limit, 0 if fixed */
+
+		/* Last read filled the get area completely */
+		bool gafull;
 
 		std::ios_base::openmode mode;
 
 		bool is_open, auto_delete_base;
 
+		/* Supplies new buffers, 0 to use new[] */
+		socketbuf_allocator* allocator;
+
+		/* Allocator and size of base if auto_delete_base is set */
+		socketbuf_allocator* base_allocator;
+		std::size_t base_size;
+
+		/* Give base back while no input or output is buffered */
+		bool idle_release;
+
+		/* Options set while closed, for every socket opened later */
+		std::vector<socket_option> preset_options;
+
+		flush_policy flush_mode;
+
+		/* Microseconds a coalesced flush may wait */
+		long flush_delay;
+
+		/* Time the socket was corked for a coalesced flush, -1 if not */
+		long flush_since;
+
+		long
+			connect_timeout, /* milliseconds, -1 for no limit */
+			read_timeout, /* milliseconds, -1 for no limit */
+			write_timeout; /* milliseconds, -1 for no limit */
+
+		/* Time the current operation gives up, -1 until it waits */
+		long deadline;
+
+		/* Last operation gave up because its time limit passed */
+		bool expired;
+
+		bool
+			nonblocking, /* socket is in non-blocking mode */
+			blocked; /* last I/O stopped because it would block */
+
+		/* Smallest write sent with MSG_ZEROCOPY, 0 if disabled */
+		std::streamsize zerocopy_threshold;
+
+		/* Wait for the kernel to release zero-copy data before returning */
+		bool zerocopy_wait;
+
+		unsigned
+			zerocopy_sent, /* zero-copy sends issued */
+			zerocopy_done; /* sends before this one have completed */
+
+		/* Completions received ahead of zerocopy_done, first to last */
+		std::map<unsigned, unsigned> zerocopy_early;
+
 		basic_socketbuf_base();
 #if __cplusplus >= 201103L
 		basic_socketbuf_base(const basic_socketbuf_base&) = delete;
@@ -42,7 +116,8 @@ namespace swoope {
 #endif
 		virtual ~basic_socketbuf_base();
 		void release_base();
-		void reset_base(char* p, bool auto_delete);
+		char* allocate_base(std::size_t n);
+		void reset_base(char* p, bool auto_delete, std::size_t n = 0);
 
 #if __cplusplus < 201103L
 	private:
@@ -51,26 +126,33 @@ namespace swoope {
 	};
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	inline void 
-	swap(basic_socketbuf_base<SocketTraits>& a, basic_socketbuf_base<
-							SocketTraits>& b)
+	swap(basic_socketbuf_base<SocketTraits, BufferPolicy>& a,
+		basic_socketbuf_base<SocketTraits, BufferPolicy>& b)
 	{
 		a.swap(b);
 	}
 #endif
 
-	template <class SocketTraits>
+	/*
+	 * BufferPolicy decides where the get and put areas live: dynamic_buffer
+	 * allocates them at run time, inline_buffer<GetSize, PutSize> keeps
+	 * them inside the object.
+	 */
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
 	class basic_socketbuf :
 	public std::streambuf,
-	private basic_socketbuf_base<SocketTraits> {
+	private basic_socketbuf_base<SocketTraits, BufferPolicy> {
 	public:
-		typedef basic_socketbuf_base<SocketTraits>
+		typedef basic_socketbuf_base<SocketTraits, BufferPolicy>
 					__socketbuf_base_type;
 		typedef std::streambuf __streambuf_type;
 	
 		typedef SocketTraits socket_traits_type;
+		typedef BufferPolicy buffer_policy_type;
 		typedef typename socket_traits_type::socket_type socket_type;
+		typedef typename socket_traits_type::address_type address_type;
 
 		typedef char char_type;
 		typedef std::char_traits<char_type> traits_type;
@@ -104,19 +186,45 @@ namespace swoope {
 		basic_socketbuf* open(const std::string& host,
 					const std::string& service,
 					std::ios_base::openmode mode);
+		/*
+		 * Same as above, with options that set how long each address is
+		 * given before the next one is tried, and the overall time limit.
+		 * Returns this on success.
+		 */
+		basic_socketbuf* open(const std::string& host,
+					const std::string& service,
+					const connect_options& options,
+					std::ios_base::openmode mode);
 		/* 
 		 * Create an underlying TCP/IP socket, bind it to the specified port or
 		 * service, then make it listen for connections with the specified backlog.
 		 * Returns this on success.
 		 */
 		basic_socketbuf* open(const std::string& service, int backlog);
+		/*
+		 * Same as above, with options applied to the socket before it is
+		 * bound, for example SO_REUSEPORT so that one listener per thread
+		 * can share the port. Returns this on success.
+		 */
+		basic_socketbuf* open(const std::string& service, int backlog,
+					const listener_options& options);
 		/*
 		 * Accepts a pending connection from this socket and stores the resulting 
 		 * connected socket into socketbuf_result. The string representation of 
 		 * the connected socket's address will be stored in address_result. Returns
 		 * this on success.
+		 *
+		 * The peer's endpoint is recorded at once, and the new socket is
+		 * close-on-exec and non-blocking if this one is.
 		 */
 		basic_socketbuf* accept(basic_socketbuf& d_socketbuf);
+		/*
+		 * Accepts up to max pending connections into d[0] through
+		 * d[max - 1], stopping when the backlog is empty, and returns how
+		 * many were accepted. Only the first accept waits on a blocking
+		 * socket.
+		 */
+		std::size_t accept_many(basic_socketbuf* d, std::size_t max);
 		/*
 		 * Returns a string representing the address to which the socket is
 		 * bound.
@@ -127,6 +235,16 @@ namespace swoope {
 		 * to the socket.
 		 */
 		std::string remote_address() const;
+		/*
+		 * Returns the address and port to which the socket is bound. It is
+		 * looked up on the first call and cached until close().
+		 */
+		const endpoint& local_endpoint() const;
+		/*
+		 * Returns the address and port of the peer, recorded by accept or
+		 * looked up on the first call, and cached until close().
+		 */
+		const endpoint& remote_endpoint() const;
 		/*
 		 * Shutdowns down the socket for input, output, or both. Possible values
 		 * for how are: std::ios_base::in, std::ios_base::out, or
@@ -137,6 +255,152 @@ namespace swoope {
 		basic_socketbuf* close();
 		/* Returns the underlying socket descriptor. */
 		socket_type socket() const;
+		/*
+		 * Switches the socket between blocking and non-blocking I/O. In
+		 * non-blocking mode, reads and accepts that cannot complete return
+		 * nothing, and output that cannot be sent stays in the put area
+		 * until the next overflow or sync. Such a sync succeeds with
+		 * would_block() set, but a write that does not fit beside the
+		 * retained output fails. Returns this on success.
+		 */
+		basic_socketbuf* set_blocking(bool blocking);
+		/*
+		 * Returns true if the last input, output or accept operation
+		 * stopped because the non-blocking socket was not ready.
+		 */
+		bool would_block() const;
+		/*
+		 * Sends output of at least threshold bytes that bypasses the put
+		 * area with MSG_ZEROCOPY, so the kernel transmits straight from the
+		 * caller's pages. If wait is true, output does not return until the
+		 * kernel has released those pages. Otherwise the caller must leave
+		 * the data unchanged until zerocopy_complete(zerocopy_sequence())
+		 * returns true. A threshold of 0 disables zero-copy sends. Returns
+		 * this on success.
+		 */
+		basic_socketbuf* set_zerocopy(std::streamsize threshold,
+							bool wait = true);
+		/*
+		 * Returns the number of zero-copy sends issued so far. Data handed
+		 * over before this call is covered by that sequence number.
+		 */
+		unsigned zerocopy_sequence() const;
+		/*
+		 * Collects pending completions without blocking and returns true if
+		 * every zero-copy send before sequence number seq has completed.
+		 */
+		bool zerocopy_complete(unsigned seq);
+		/*
+		 * Blocks until every zero-copy send has completed. Returns this on
+		 * success.
+		 */
+		basic_socketbuf* zerocopy_flush();
+		/*
+		 * Flushes the put area, then sends length bytes of file descriptor
+		 * fd starting at offset straight from the kernel's page cache.
+		 * Returns the number of bytes sent, which is short at end of file,
+		 * on error, or when a non-blocking socket fills up.
+		 */
+		std::streamsize send_file(int fd, off_t offset,
+						std::size_t length);
+		/*
+		 * Flushes the put area, then sends the n bytes of s, at least one,
+		 * with count file descriptors attached. The peer collects them
+		 * with receive_descriptors once it has read those bytes. Needs
+		 * socket traits that pass descriptors, such as
+		 * unix_socket_traits. Returns this on success.
+		 */
+		basic_socketbuf* send_descriptors(const int* fds,
+					std::size_t count, const char_type* s,
+					std::streamsize n);
+		/*
+		 * Moves up to max file descriptors that came with the input read
+		 * so far into fds, oldest first, and returns how many. The caller
+		 * owns and closes them.
+		 */
+		std::size_t receive_descriptors(int* fds, std::size_t max);
+		/*
+		 * Sets the get area to gsize bytes and the put area to psize bytes,
+		 * also while the socketbuf is open. Unread input is kept, and
+		 * pending output is kept or flushed if it does not fit. gsize must
+		 * be at least 1 and psize may be 0 for unbuffered output. Returns
+		 * this on success.
+		 */
+		basic_socketbuf* set_buffer_sizes(std::streamsize gsize,
+						std::streamsize psize);
+		/*
+		 * Lets underflow double the get area, up to max bytes, after a read
+		 * fills it completely. A max of 0 keeps the get area size fixed.
+		 * Returns this.
+		 */
+		basic_socketbuf* set_input_growth(std::streamsize max);
+		/*
+		 * Makes the socketbuf take its buffers from a, or from new[] if a
+		 * is 0. a must outlive every buffer it supplies. Sockets accepted
+		 * from this socketbuf use the same allocator unless they have their
+		 * own, and a buffer from an allocator is given back on close().
+		 * Returns this.
+		 */
+		basic_socketbuf* set_allocator(socketbuf_allocator* a);
+		/*
+		 * Lets the socketbuf give its buffer back to the allocator while
+		 * the get area is drained and the put area is flushed, and take a
+		 * new one when input arrives or output is written. A read keeps
+		 * the buffer if input is already queued, and otherwise awaits
+		 * input without one. Buffers given with setbuf and inline buffers
+		 * are kept. Sockets accepted from this socketbuf inherit the
+		 * setting. Returns this.
+		 */
+		basic_socketbuf* set_idle_release(bool release);
+		/*
+		 * Sets a socket option, for example set_option(tcp_nodelay(true)).
+		 * While the socketbuf is closed, the option is recorded instead
+		 * and set on every socket that open() creates, before it connects
+		 * or listens. Returns this on success.
+		 */
+		basic_socketbuf* set_option(const socket_option& option);
+		/*
+		 * Stores the current value of option name of the socket in value.
+		 * Returns this on success.
+		 */
+		basic_socketbuf* get_option(socket_option::name_type name,
+								int& value);
+		/*
+		 * Sets when sync() sends the put area. With flush_coalesce, the
+		 * first deferred sync corks the socket (TCP_CORK) and every sync
+		 * hands the put area to the system, which holds partial
+		 * segments back until the oldest deferred flush is delay
+		 * microseconds old, rounded up to whole milliseconds, or for at
+		 * most its own limit (200 ms on Linux). Deferred output is also
+		 * sent before the socketbuf reads, and a full put area is sent
+		 * with MSG_MORE so that the system fills whole segments. Where
+		 * the socket cannot be corked, every sync sends. With
+		 * flush_explicit, only push() and a full put area send. Sockets
+		 * accepted from this socketbuf inherit the policy. Returns this.
+		 */
+		basic_socketbuf* set_flush_policy(flush_policy policy,
+							long delay = 200);
+		/*
+		 * Sends the put area now, whatever the flush policy. close() and
+		 * shutdown() push as well. Returns this on success.
+		 */
+		basic_socketbuf* push();
+		/*
+		 * Limits, in milliseconds, how long connecting, and each read,
+		 * accept or write of a blocking socketbuf, may wait. -1 means no
+		 * limit. The socket is kept non-blocking underneath and waited
+		 * on with poll. An operation that runs out of time fails, with
+		 * unsent output kept in the put area, and timed_out() returns
+		 * true until the next operation. Sockets accepted from this
+		 * socketbuf inherit the limits. Returns this on success.
+		 */
+		basic_socketbuf* set_timeouts(long connect, long read,
+								long write);
+		/*
+		 * Returns true if the last connect, input or output operation
+		 * failed because its time limit passed.
+		 */
+		bool timed_out() const;
 	protected:
 		basic_socketbuf* setbuf(char_type* s, std::streamsize n);
 		int sync();
@@ -149,16 +413,42 @@ namespace swoope {
 		basic_socketbuf& operator=(const basic_socketbuf& rhs);
 #endif
 		basic_socketbuf(const basic_socketbuf& rhs);
+		basic_socketbuf* accept(basic_socketbuf& d_socketbuf, bool nb);
 		void init_io();
+		bool idle() const;
+		void release_idle();
+		std::streamsize read_queued();
+		bool wait_input();
+		bool defer_flush();
+		bool timed() const;
+		void arm();
+		bool retry(std::ios_base::openmode which);
 		std::streamsize read(char_type* s, std::streamsize n);
-		std::streamsize write(const char_type* s, std::streamsize n);
+		std::streamsize read(char_type* s1, std::streamsize n1,
+				char_type* s2, std::streamsize n2);
+		std::streamsize read_all(char_type* s, std::streamsize n);
+		bool retained() const;
+		void retain(std::streamsize sent);
+		bool resize(std::streamsize gsize, std::streamsize psize);
+		std::streamsize get_area_size() const;
+		std::streamsize put_area_size() const;
+		char_type* own_storage();
+		void relocate(char_type* from, char_type* to);
+		std::streamsize write_zerocopy(const char_type* s,
+							std::streamsize n);
+		void zerocopy_record(unsigned first, unsigned last);
+		std::streamsize write(const char_type* s, std::streamsize n,
+							bool more = false);
+		std::streamsize write(const char_type* s1, std::streamsize n1,
+				const char_type* s2, std::streamsize n2,
+				bool more = false);
 	};
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	inline void 
-	swap(basic_socketbuf<SocketTraits>& a,
-		basic_socketbuf<SocketTraits>& b)
+	swap(basic_socketbuf<SocketTraits, BufferPolicy>& a,
+		basic_socketbuf<SocketTraits, BufferPolicy>& b)
 	{
 		a.swap(b);
 	}
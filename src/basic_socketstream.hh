@@ -12,11 +12,12 @@
 
 namespace swoope {
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy = dynamic_buffer>
 	class basic_socketstream :
 	public std::iostream {
 	public:
-		typedef basic_socketbuf<SocketTraits> __socketbuf_type;
+		typedef basic_socketbuf<SocketTraits, BufferPolicy>
+							__socketbuf_type;
 		typedef std::iostream __iostream_type;
 
 		typedef typename __socketbuf_type::socket_type socket_type;
@@ -55,6 +56,17 @@ namespace swoope {
 			open(host, service, mode);
 		}
 
+		basic_socketstream(const std::string& host,
+				const std::string& service,
+				const connect_options& options,
+				std::ios_base::openmode mode =
+				std::ios_base::in | std::ios_base::out) :
+			__iostream_type(&buf),
+			buf()
+		{
+			open(host, service, options, mode);
+		}
+
 #if __cplusplus >= 201103L
 		basic_socketstream(const basic_socketstream&) = delete;
 
@@ -115,6 +127,17 @@ namespace swoope {
 				this->clear();
 		}
 
+		void open(const std::string& host, const std::string& service,
+					const connect_options& options,
+					std::ios_base::openmode mode =
+					std::ios_base::in | std::ios_base::out)
+		{
+			if (rdbuf()->open(host, service, options, mode) == 0)
+				this->setstate(std::ios_base::failbit);
+			else
+				this->clear();
+		}
+
 		void open(const std::string& service, int backlog)
 		{
 			if (rdbuf()->open(service, backlog) == 0)
@@ -123,6 +146,15 @@ namespace swoope {
 				this->clear();
 		}
 
+		void open(const std::string& service, int backlog,
+				const listener_options& options)
+		{
+			if (rdbuf()->open(service, backlog, options) == 0)
+				this->setstate(std::ios_base::failbit);
+			else
+				this->clear();
+		}
+
 		void accept(basic_socketstream& d_socketstream)
 		{
 			rdbuf()->accept(*(d_socketstream.rdbuf()));
@@ -138,6 +170,16 @@ namespace swoope {
 			return rdbuf()->remote_address();
 		}
 
+		const endpoint& local_endpoint() const
+		{
+			return rdbuf()->local_endpoint();
+		}
+
+		const endpoint& remote_endpoint() const
+		{
+			return rdbuf()->remote_endpoint();
+		}
+
 		void shutdown(std::ios_base::openmode how)
 		{
 			if (rdbuf()->shutdown(how) == 0)
@@ -150,14 +192,78 @@ namespace swoope {
 				this->setstate(std::ios_base::failbit);
 		}
 
+		void set_blocking(bool blocking)
+		{
+			if (rdbuf()->set_blocking(blocking) == 0)
+				this->setstate(std::ios_base::failbit);
+		}
+
+		bool would_block() const
+		{
+			return rdbuf()->would_block();
+		}
+
+		void set_option(const socket_option& option)
+		{
+			if (rdbuf()->set_option(option) == 0)
+				this->setstate(std::ios_base::failbit);
+		}
+
+		void get_option(socket_option::name_type name, int& value)
+		{
+			if (rdbuf()->get_option(name, value) == 0)
+				this->setstate(std::ios_base::failbit);
+		}
+
+		void set_flush_policy(flush_policy policy, long delay = 200)
+		{
+			rdbuf()->set_flush_policy(policy, delay);
+		}
+
+		void push()
+		{
+			if (rdbuf()->push() == 0)
+				this->setstate(std::ios_base::badbit);
+		}
+
+		void set_timeouts(long connect, long read, long write)
+		{
+			if (rdbuf()->set_timeouts(connect, read, write) == 0)
+				this->setstate(std::ios_base::failbit);
+		}
+
+		bool timed_out() const
+		{
+			return rdbuf()->timed_out();
+		}
+
+		void send_file(int fd, off_t offset, std::size_t length)
+		{
+			if (rdbuf()->send_file(fd, offset, length) !=
+				static_cast<std::streamsize>(length))
+				this->setstate(std::ios_base::failbit);
+		}
+
+		void send_descriptors(const int* fds, std::size_t count,
+					const char_type* s, std::streamsize n)
+		{
+			if (rdbuf()->send_descriptors(fds, count, s, n) == 0)
+				this->setstate(std::ios_base::failbit);
+		}
+
+		std::size_t receive_descriptors(int* fds, std::size_t max)
+		{
+			return rdbuf()->receive_descriptors(fds, max);
+		}
+
 	private:
 		__socketbuf_type buf;
 	};
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
-	inline void swap(basic_socketstream<SocketTraits>& a,
-			basic_socketstream<SocketTraits>& b)
+	template <class SocketTraits, class BufferPolicy>
+	inline void swap(basic_socketstream<SocketTraits, BufferPolicy>& a,
+			basic_socketstream<SocketTraits, BufferPolicy>& b)
 	{
 		a.swap(b);
 	}
@@ -0,0 +1,57 @@
+#ifndef SWOOPE_BUFFER_POLICY_HH
+#define SWOOPE_BUFFER_POLICY_HH
+
+/*
+ * buffer_policy.hh
+ */
+
+#include <algorithm>
+#include <cstddef>
+
+namespace swoope {
+
+	/*
+	 * Buffer policy whose get and put areas are allocated at run time,
+	 * with sizes chosen by setbuf or set_buffer_sizes.
+	 */
+	struct dynamic_buffer {
+		static const bool is_inline = false;
+		static const std::size_t get_size = 0, put_size = 0;
+
+		char* data()
+		{
+			return 0;
+		}
+
+		void swap(dynamic_buffer&)
+		{
+		}
+	};
+
+	/*
+	 * Buffer policy that keeps a get area of GetSize bytes and a put area
+	 * of PutSize bytes inside the socketbuf itself. The socketbuf never
+	 * allocates, and its buffer sizes cannot be changed.
+	 */
+	template <std::size_t GetSize, std::size_t PutSize = GetSize>
+	struct inline_buffer {
+		static const bool is_inline = true;
+		static const std::size_t get_size = GetSize, put_size = PutSize;
+
+		char storage[GetSize + PutSize];
+
+		char* data()
+		{
+			return storage;
+		}
+
+		void swap(inline_buffer& rhs)
+		{
+			std::swap_ranges(storage, storage + GetSize + PutSize,
+								rhs.storage);
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SWOOPE_CONNECT_OPTIONS_HH
+#define SWOOPE_CONNECT_OPTIONS_HH
+
+/*
+ * connect_options.hh
+ */
+
+#include "socket_option.hh"
+#include <vector>
+
+namespace swoope {
+
+	class resolver_cache;
+
+	/*
+	 * Settings for connecting to a host name that resolves to several
+	 * addresses. The addresses are tried in turn, alternating between
+	 * IPv6 and IPv4, and an attempt that is still pending does not stop
+	 * the next one from starting (RFC 8305).
+	 */
+	struct connect_options {
+		/*
+		 * Milliseconds to wait for an attempt before the next address
+		 * is tried as well
+		 */
+		int attempt_delay;
+
+		/* Milliseconds the whole connect may take, or -1 for no limit */
+		int timeout;
+
+		/* Cache to resolve the host through, 0 to call getaddrinfo (C++11) */
+		resolver_cache* resolver;
+
+		/* Options set on each socket before it connects */
+		std::vector<socket_option> socket_options;
+
+		connect_options() :
+		attempt_delay(250),
+		timeout(-1),
+		resolver(0),
+		socket_options()
+		{
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SWOOPE_DATAGRAM_HH
+#define SWOOPE_DATAGRAM_HH
+
+/*
+ * datagram.hh
+ */
+
+#include <cstddef>
+#include "endpoint.hh"
+
+namespace swoope {
+
+	/* One message of a batch sent or received by a datagram socket */
+	struct datagram {
+		/* Message bytes, or the buffer a message is received into */
+		char* data;
+
+		std::size_t
+			capacity, /* bytes data can hold when receiving */
+			size; /* bytes to send, or bytes received */
+
+		/*
+		 * Where to send the message, or where it came from. Left empty
+		 * to send to the peer of a connected socket.
+		 */
+		endpoint peer;
+
+		/*
+		 * When sending, splits the message into segments of this many
+		 * bytes in the kernel or NIC (UDP GSO). When receiving with GRO,
+		 * the size of the segments the message was coalesced from. 0
+		 * for a single packet.
+		 */
+		std::size_t segment_size;
+
+		/*
+		 * Set when receiving if the message was larger than capacity and
+		 * the rest of it was discarded.
+		 */
+		bool truncated;
+
+		datagram() :
+		data(0),
+		capacity(0),
+		size(0),
+		peer(),
+		segment_size(0),
+		truncated(false)
+		{
+		}
+
+		datagram(char* p, std::size_t n) :
+		data(p),
+		capacity(n),
+		size(n),
+		peer(),
+		segment_size(0),
+		truncated(false)
+		{
+		}
+	};
+
+}
+
+#endif
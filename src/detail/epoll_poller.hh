@@ -0,0 +1,110 @@
+#ifndef SWOOPE_EPOLL_POLLER_HH
+#define SWOOPE_EPOLL_POLLER_HH
+
+/*
+ * epoll_poller.hh
+ */
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace swoope {
+
+	struct epoll_poller {
+		typedef int handle_type;
+		typedef epoll_event event_type;
+
+		enum {
+			readable = 1,
+			writable = 2,
+			closed = 4
+		};
+
+		static handle_type invalid()
+		{
+			return static_cast<handle_type>(-1);
+		}
+
+		static handle_type open()
+		{
+			return ::epoll_create1(EPOLL_CLOEXEC);
+		}
+
+		static int close(handle_type poller)
+		{
+			return ::close(poller);
+		}
+
+		/*
+		 * Registers descriptor fd for edge-triggered notification of the
+		 * given events. data is handed back with every event.
+		 */
+		static int add(handle_type poller, int fd, int events,
+								void* data)
+		{
+			return control(poller, EPOLL_CTL_ADD, fd, events, data);
+		}
+
+		static int modify(handle_type poller, int fd, int events,
+								void* data)
+		{
+			return control(poller, EPOLL_CTL_MOD, fd, events, data);
+		}
+
+		static int remove(handle_type poller, int fd)
+		{
+			epoll_event ev = epoll_event();
+
+			return ::epoll_ctl(poller, EPOLL_CTL_DEL, fd, &ev);
+		}
+
+		/*
+		 * Waits up to timeout milliseconds (-1 for no limit) for events.
+		 * Returns the number of events stored in evs, 0 on timeout or
+		 * interruption, or -1 on error.
+		 */
+		static int wait(handle_type poller, event_type* evs, int max,
+								int timeout)
+		{
+			int result(::epoll_wait(poller, evs, max, timeout));
+
+			if (result == -1 && errno == EINTR) result = 0;
+			return result;
+		}
+
+		static void* data(const event_type& ev)
+		{
+			return ev.data.ptr;
+		}
+
+		static int events(const event_type& ev)
+		{
+			int result(0);
+
+			if ((ev.events & (EPOLLIN | EPOLLPRI)) != 0)
+				result |= readable;
+			if ((ev.events & EPOLLOUT) != 0)
+				result |= writable;
+			if ((ev.events & (EPOLLHUP | EPOLLRDHUP |
+							EPOLLERR)) != 0)
+				result |= closed;
+			return result;
+		}
+	private:
+		static int control(handle_type poller, int op, int fd,
+						int events, void* data)
+		{
+			epoll_event ev = epoll_event();
+
+			ev.events = EPOLLET | EPOLLRDHUP;
+			if ((events & readable) != 0) ev.events |= EPOLLIN;
+			if ((events & writable) != 0) ev.events |= EPOLLOUT;
+			ev.data.ptr = data;
+			return ::epoll_ctl(poller, op, fd, &ev);
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef SWOOPE_IO_URING_RING_HH
+#define SWOOPE_IO_URING_RING_HH
+
+/*
+ * io_uring_ring.hh
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace swoope {
+
+	/*
+	 * Minimal io_uring submission/completion queue pair, driven through
+	 * the raw system calls so that no liburing is needed.
+	 */
+	class io_uring_ring {
+	public:
+		explicit io_uring_ring(unsigned entries) :
+		fd(-1),
+		sq_ptr(MAP_FAILED),
+		cq_ptr(MAP_FAILED),
+		sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+		sq_len(0),
+		cq_len(0),
+		sqes_len(0),
+		sq_local_tail(0)
+		{
+			io_uring_params p;
+
+			std::memset(&p, 0, sizeof(p));
+			fd = static_cast<int>(::syscall(__NR_io_uring_setup,
+								entries, &p));
+			if (fd < 0) {
+				fd = -1;
+				return;
+			}
+			if (map(p) != 0) {
+				unmap();
+				::close(fd);
+				fd = -1;
+			}
+		}
+
+		~io_uring_ring()
+		{
+			if (fd != -1) {
+				unmap();
+				::close(fd);
+			}
+		}
+
+		bool is_open() const
+		{
+			return fd != -1;
+		}
+
+		/*
+		 * Returns a zeroed submission entry, submitting queued entries
+		 * first if the queue is full. Returns 0 if no entry is available.
+		 */
+		io_uring_sqe* get_sqe()
+		{
+			unsigned head(__atomic_load_n(sq_head, __ATOMIC_ACQUIRE));
+			io_uring_sqe* result;
+
+			if (sq_local_tail - head >= *sq_entries) {
+				if (submit(0) < 0) return 0;
+				head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+				if (sq_local_tail - head >= *sq_entries) return 0;
+			}
+			result = &sqes[sq_local_tail & *sq_mask];
+			std::memset(result, 0, sizeof(*result));
+			++sq_local_tail;
+			return result;
+		}
+
+		/*
+		 * Hands every queued submission entry to the kernel and waits for
+		 * at least wait_nr completions. Returns the number of entries
+		 * submitted or -1 on error.
+		 */
+		int submit(unsigned wait_nr)
+		{
+			unsigned tail(*sq_tail), to_submit(sq_local_tail - tail);
+			long result;
+
+			__atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+			if (to_submit == 0 && wait_nr == 0) return 0;
+			do {
+				result = ::syscall(__NR_io_uring_enter, fd,
+					to_submit, wait_nr, wait_nr != 0 ?
+					IORING_ENTER_GETEVENTS : 0, 0, 0);
+			} while (result == -1 && errno == EINTR &&
+							to_submit != 0);
+			if (result == -1 && errno == EINTR) result = 0;
+			return static_cast<int>(result);
+		}
+
+		/*
+		 * Copies the oldest completion into cqe and removes it from the
+		 * queue. Returns false if there is none.
+		 */
+		bool next_cqe(io_uring_cqe& cqe)
+		{
+			unsigned head(*cq_head);
+
+			if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+				return false;
+			cqe = cqes[head & *cq_mask];
+			__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+	private:
+		io_uring_ring(const io_uring_ring&);
+		io_uring_ring& operator=(const io_uring_ring&);
+
+		int map(const io_uring_params& p)
+		{
+			char *sq, *cq;
+
+			sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+			cq_len = p.cq_off.cqes + p.cq_entries *
+						sizeof(io_uring_cqe);
+#if defined(IORING_FEAT_SINGLE_MMAP)
+			if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+				if (cq_len > sq_len) sq_len = cq_len;
+				cq_len = 0;
+			}
+#endif
+			sq_ptr = ::mmap(0, sq_len, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, fd,
+					IORING_OFF_SQ_RING);
+			if (sq_ptr == MAP_FAILED) return -1;
+			if (cq_len != 0) {
+				cq_ptr = ::mmap(0, cq_len, PROT_READ |
+					PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					fd, IORING_OFF_CQ_RING);
+				if (cq_ptr == MAP_FAILED) return -1;
+			}
+			sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(::mmap(0, sqes_len,
+					PROT_READ | PROT_WRITE, MAP_SHARED |
+					MAP_POPULATE, fd, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED) return -1;
+
+			sq = static_cast<char*>(sq_ptr);
+			cq = static_cast<char*>(cq_len != 0 ? cq_ptr : sq_ptr);
+			sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+			sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+			sq_mask = reinterpret_cast<unsigned*>(sq +
+							p.sq_off.ring_mask);
+			sq_entries = reinterpret_cast<unsigned*>(sq +
+						p.sq_off.ring_entries);
+			cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+			cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+			cq_mask = reinterpret_cast<unsigned*>(cq +
+							p.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq +
+							p.cq_off.cqes);
+
+			/* Submission slots always map to the entry of same index */
+			unsigned* array(reinterpret_cast<unsigned*>(sq +
+							p.sq_off.array));
+			for (unsigned i = 0; i < p.sq_entries; ++i)
+				array[i] = i;
+			sq_local_tail = *sq_tail;
+			return 0;
+		}
+
+		void unmap()
+		{
+			if (sqes != MAP_FAILED) ::munmap(sqes, sqes_len);
+			if (cq_ptr != MAP_FAILED) ::munmap(cq_ptr, cq_len);
+			if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_len);
+		}
+
+		int fd;
+		void *sq_ptr, *cq_ptr;
+		io_uring_sqe* sqes;
+		io_uring_cqe* cqes;
+		std::size_t sq_len, cq_len, sqes_len;
+		unsigned *sq_head, *sq_tail, *sq_mask, *sq_entries;
+		unsigned *cq_head, *cq_tail, *cq_mask;
+		unsigned sq_local_tail;
+	};
+
+}
+
+#endif
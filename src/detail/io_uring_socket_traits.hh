@@ -0,0 +1,579 @@
+#ifndef SWOOPE_IO_URING_SOCKET_TRAITS_HH
+#define SWOOPE_IO_URING_SOCKET_TRAITS_HH
+
+/*
+ * io_uring_socket_traits.hh
+ */
+
+#include "posix_native_socket_traits.hh"
+#include "io_uring_ring.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+#include <fcntl.h>
+
+namespace swoope {
+
+	struct io_uring_options {
+		/* Submission queue size of each thread's ring */
+		unsigned entries;
+
+		/*
+		 * Number and size of the buffers handed to the kernel for
+		 * provided-buffer receives. A count of 0, or kernel headers
+		 * without IOSQE_BUFFER_SELECT, make reads receive directly
+		 * into the caller's buffer.
+		 */
+		unsigned buffer_count, buffer_size;
+
+		/*
+		 * Keep one accept armed per listener instead of one per call,
+		 * where the kernel headers define IORING_ACCEPT_MULTISHOT
+		 */
+		bool multishot_accept;
+
+		io_uring_options() :
+		entries(256),
+		buffer_count(0),
+		buffer_size(4096),
+		multishot_accept(true)
+		{
+		}
+	};
+
+	/*
+	 * Socket traits that perform accept, receive and send through an
+	 * io_uring shared by every socket of the calling thread. The stream
+	 * API waits for the result of each read and write, so each costs one
+	 * io_uring_enter, as many system calls as recv and send. Only
+	 * submissions that need no answer, such as returning provided
+	 * buffers, are queued and reach the kernel together with the next
+	 * operation. Falls back to native_socket_traits if no ring can be
+	 * created.
+	 */
+	struct io_uring_socket_traits : native_socket_traits {
+
+		/*
+		 * Options used for each thread's ring. Changes apply to threads
+		 * that have not used the traits yet.
+		 */
+		static io_uring_options& options()
+		{
+			static io_uring_options result;
+			return result;
+		}
+
+		static socket_type open(const std::string& host,
+					const std::string& service)
+		{
+			socket_type result((native_socket_traits::open(host,
+								service)));
+
+			if (result != invalid()) mark_nonblocking(result, false);
+			return result;
+		}
+
+		static socket_type open(const std::string& host,
+					const std::string& service,
+					const connect_options& options)
+		{
+			socket_type result((native_socket_traits::open(host,
+							service, options)));
+
+			if (result != invalid()) mark_nonblocking(result, false);
+			return result;
+		}
+
+		static socket_type open(const std::string& service,
+							int backlog)
+		{
+			socket_type result((native_socket_traits::open(service,
+								backlog)));
+
+			if (result != invalid()) mark_nonblocking(result, false);
+			return result;
+		}
+
+		static socket_type open(const std::string& service,
+					int backlog,
+					const listener_options& options)
+		{
+			socket_type result((native_socket_traits::open(service,
+							backlog, options)));
+
+			if (result != invalid()) mark_nonblocking(result, false);
+			return result;
+		}
+
+		static socket_type accept(socket_type sock)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+
+			if (c.ring.is_open() == false)
+				return native_socket_traits::accept(sock);
+			listener& l(c.listeners[sock]);
+			for (;;) {
+				if (l.ready.empty() == false) {
+					socket_type result((l.ready.front()));
+					l.ready.pop_front();
+					mark_nonblocking(result, false);
+					return result;
+				}
+				if (l.error == EINVAL && l.multishot != false) {
+					/* Kernel without multishot accept */
+					l.multishot = false;
+					l.error = 0;
+				}
+				if (l.error != 0) {
+					errno = l.error;
+					l.error = 0;
+					return invalid();
+				}
+				if (l.armed == false) {
+					if ((sqe = c.ring.get_sqe()) == 0)
+						return native_socket_traits::
+								accept(sock);
+					sqe->opcode = IORING_OP_ACCEPT;
+					sqe->fd = sock;
+#if defined(IORING_ACCEPT_MULTISHOT)
+					if (l.multishot != false)
+						sqe->ioprio =
+							IORING_ACCEPT_MULTISHOT;
+#endif
+					sqe->user_data = accept_tag | static_cast<
+						__u64>(static_cast<unsigned>(sock));
+					l.armed = true;
+				}
+				if (is_nonblocking(sock) != false) {
+					c.ring.submit(0);
+					c.drain();
+					if (l.ready.empty() != false &&
+							l.error == 0) {
+						errno = EAGAIN;
+						return invalid();
+					}
+				} else {
+					if (c.ring.submit(1) < 0) return invalid();
+					c.drain();
+				}
+			}
+		}
+
+		/*
+		 * The ring accepts into a shared multishot slot, so the peer
+		 * address is looked up afterwards.
+		 */
+		static socket_type accept(socket_type sock, address_type& peer,
+							bool nonblocking)
+		{
+			socket_type result((accept(sock)));
+			socklen_t len(sizeof(peer));
+
+			if (result == invalid()) return result;
+			if (::getpeername(result, (sockaddr*)&peer, &len) != 0 ||
+				::fcntl(result, F_SETFD, FD_CLOEXEC) == -1 ||
+				(nonblocking != false &&
+				set_blocking(result, false) != 0)) {
+				close(result);
+				result = invalid();
+			}
+			return result;
+		}
+
+		static std::streamsize read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+			__u32 flags;
+			int res;
+
+			if (c.ring.is_open() == false ||
+					(sqe = c.ring.get_sqe()) == 0)
+				return native_socket_traits::read(socket, buf, n);
+			sqe->opcode = IORING_OP_RECV;
+			sqe->fd = socket;
+			sqe->msg_flags = dontwait(socket);
+			sqe->addr = reinterpret_cast<__u64>(buf);
+			sqe->len = static_cast<__u32>(n);
+#if defined(IOSQE_BUFFER_SELECT)
+			if (c.buffers_ok != false) {
+				sqe->addr = 0;
+				sqe->flags = IOSQE_BUFFER_SELECT;
+				sqe->buf_group = buffer_group;
+				sqe->len = static_cast<__u32>(std::min(n,
+					static_cast<std::streamsize>(
+							c.buffer_size)));
+			}
+#endif
+			res = c.complete(sqe, flags);
+#if defined(IOSQE_BUFFER_SELECT)
+			if ((flags & IORING_CQE_F_BUFFER) != 0) {
+				unsigned bid(flags >> IORING_CQE_BUFFER_SHIFT);
+				if (res > 0)
+					std::copy(&c.buffers[bid * c.buffer_size],
+						&c.buffers[bid * c.buffer_size] +
+						res, static_cast<char*>(buf));
+				c.provide(bid, 1, 0);
+			} else if (res == -ENOBUFS) {
+				/* Every provided buffer is in use */
+				return native_socket_traits::read(socket, buf, n);
+			}
+#endif
+			return completed(res);
+		}
+
+		static std::streamsize read_all(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+			std::streamsize result(0);
+			__u32 flags;
+			int res(0);
+
+			if (c.ring.is_open() == false)
+				return native_socket_traits::read_all(socket,
+								buf, n);
+			while (result < n) {
+				if ((sqe = c.ring.get_sqe()) == 0) break;
+				sqe->opcode = IORING_OP_RECV;
+				sqe->fd = socket;
+				sqe->addr = reinterpret_cast<__u64>(
+					static_cast<char*>(buf) + result);
+				sqe->len = static_cast<__u32>(n - result);
+				sqe->msg_flags = MSG_WAITALL | dontwait(socket);
+				res = c.complete(sqe, flags);
+				if (res <= 0) break;
+				result += res;
+			}
+			if (result == 0 && res < 0) return completed(res);
+			return result;
+		}
+
+		static std::streamsize read(socket_type socket,
+						void* buf1,
+						std::streamsize n1,
+						void* buf2,
+						std::streamsize n2)
+		{
+			msghdr msg = msghdr();
+			iovec iov[2];
+
+			iov[0].iov_base = buf1;
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = buf2;
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+			return transfer(IORING_OP_RECVMSG, socket, &msg);
+		}
+
+		static std::streamsize write(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+			__u32 flags;
+
+			if (c.ring.is_open() == false ||
+					(sqe = c.ring.get_sqe()) == 0)
+				return native_socket_traits::write(socket,
+								buf, n);
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = socket;
+			sqe->msg_flags = dontwait(socket);
+			sqe->addr = reinterpret_cast<__u64>(buf);
+			sqe->len = static_cast<__u32>(n);
+			return completed(c.complete(sqe, flags));
+		}
+
+		static std::streamsize write(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			msghdr msg = msghdr();
+			iovec iov[2];
+
+			iov[0].iov_base = const_cast<void*>(buf1);
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = const_cast<void*>(buf2);
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+			return transfer(IORING_OP_SENDMSG, socket, &msg);
+		}
+
+		static int close(socket_type socket)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+			listener_map::iterator i;
+
+			if (c.ring.is_open() != false &&
+				(i = c.listeners.find(socket)) !=
+							c.listeners.end()) {
+				if (i->second.armed != false &&
+					(sqe = c.ring.get_sqe()) != 0) {
+					sqe->opcode = IORING_OP_ASYNC_CANCEL;
+					sqe->addr = accept_tag | static_cast<
+						__u64>(static_cast<unsigned>(
+								socket));
+					c.ring.submit(0);
+				}
+				while (i->second.ready.empty() == false) {
+					native_socket_traits::close(
+						i->second.ready.front());
+					i->second.ready.pop_front();
+				}
+				c.listeners.erase(i);
+			}
+			mark_nonblocking(socket, false);
+			return native_socket_traits::close(socket);
+		}
+
+		static int set_blocking(socket_type socket, bool blocking)
+		{
+			int result((native_socket_traits::set_blocking(socket,
+								blocking)));
+
+			if (result == 0) mark_nonblocking(socket, !blocking);
+			return result;
+		}
+	private:
+		static const __u64 accept_tag = 1ULL << 63;
+		static const __u16 buffer_group = 0x5357;
+
+		struct listener {
+			std::deque<socket_type> ready;
+			int error;
+			bool armed, multishot;
+
+			listener() :
+			ready(),
+			error(0),
+			armed(false),
+#if defined(IORING_ACCEPT_MULTISHOT)
+			multishot(options().multishot_accept)
+#else
+			multishot(false)
+#endif
+			{
+			}
+		};
+
+		typedef std::map<socket_type, listener> listener_map;
+
+		struct context {
+			io_uring_ring ring;
+			listener_map listeners;
+			std::vector<char> buffers;
+			unsigned buffer_size;
+			bool buffers_ok;
+			__u64 next_tag;
+
+			explicit context(const io_uring_options& o) :
+			ring(o.entries),
+			listeners(),
+			buffers(),
+			buffer_size(o.buffer_size),
+			buffers_ok(false),
+			next_tag(1)
+			{
+#if defined(IOSQE_BUFFER_SELECT)
+				__u32 flags;
+
+				if (ring.is_open() == false ||
+						o.buffer_count == 0 ||
+						o.buffer_size == 0)
+					return;
+				buffers.resize(static_cast<std::size_t>(
+					o.buffer_count) * o.buffer_size);
+				buffers_ok = complete(provide(0,
+					o.buffer_count, 0), flags) >= 0;
+#endif
+			}
+
+#if defined(IOSQE_BUFFER_SELECT)
+			/*
+			 * Queues the return of count provided buffers starting at
+			 * bid. The entry is submitted with the next operation.
+			 */
+			io_uring_sqe* provide(unsigned bid, unsigned count,
+								__u64 tag)
+			{
+				io_uring_sqe* result((ring.get_sqe()));
+
+				if (result == 0) return result;
+				result->opcode = IORING_OP_PROVIDE_BUFFERS;
+				result->fd = static_cast<__s32>(count);
+				result->addr = reinterpret_cast<__u64>(
+					&buffers[static_cast<std::size_t>(bid) *
+							buffer_size]);
+				result->len = buffer_size;
+				result->off = bid;
+				result->buf_group = buffer_group;
+				result->user_data = tag;
+				return result;
+			}
+#endif
+
+			/*
+			 * Submits everything queued, including sqe, and waits for the
+			 * completion of sqe. Returns its result, with the completion
+			 * flags in flags, which are 0 if sqe never completed.
+			 */
+			int complete(io_uring_sqe* sqe, __u32& flags)
+			{
+				io_uring_cqe cqe;
+				__u64 tag;
+
+				flags = 0;
+				if (sqe == 0) return -ENOMEM;
+				if (sqe->user_data == 0) {
+					sqe->user_data = next_tag;
+					next_tag = (next_tag + 1) &
+							(accept_tag - 1);
+					if (next_tag == 0) next_tag = 1;
+				}
+				tag = sqe->user_data;
+				for (;;) {
+					if (ring.submit(1) < 0) return -errno;
+					while (ring.next_cqe(cqe) != false) {
+						if (cqe.user_data == tag) {
+							flags = cqe.flags;
+							return cqe.res;
+						}
+						dispatch(cqe);
+					}
+				}
+			}
+
+			void drain()
+			{
+				io_uring_cqe cqe;
+
+				while (ring.next_cqe(cqe) != false)
+					dispatch(cqe);
+			}
+
+			/* Handles a completion nobody is waiting for */
+			void dispatch(const io_uring_cqe& cqe)
+			{
+				listener_map::iterator i;
+				socket_type sock;
+
+				if ((cqe.user_data & accept_tag) == 0) return;
+				sock = static_cast<socket_type>(cqe.user_data &
+							(accept_tag - 1));
+				i = listeners.find(sock);
+				if (i == listeners.end()) {
+					/* Accepted after its listener was closed */
+					if (cqe.res >= 0)
+						native_socket_traits::close(
+								cqe.res);
+					return;
+				}
+				if (cqe.res >= 0)
+					i->second.ready.push_back(cqe.res);
+				else if (cqe.res != -ECANCELED)
+					i->second.error = -cqe.res;
+#if defined(IORING_CQE_F_MORE)
+				/* A multishot accept stays armed while MORE is set */
+				if ((cqe.flags & IORING_CQE_F_MORE) != 0) return;
+#endif
+				i->second.armed = false;
+			}
+		};
+
+		static context& instance()
+		{
+			thread_local context result(options());
+			return result;
+		}
+
+		/*
+		 * The ring waits for readiness even on O_NONBLOCK sockets, so the
+		 * mode set through set_blocking is remembered here and passed on
+		 * as MSG_DONTWAIT. Descriptors beyond the table are asked for.
+		 */
+		static std::atomic<unsigned long>* nonblocking_table()
+		{
+			static std::atomic<unsigned long> result[1024];
+			return result;
+		}
+
+		static void mark_nonblocking(socket_type socket, bool on)
+		{
+			const unsigned bits(sizeof(unsigned long) * 8);
+			unsigned i(static_cast<unsigned>(socket));
+			unsigned long mask(1UL << (i % bits));
+
+			if (socket < 0 || i / bits >= 1024) return;
+			if (on != false)
+				nonblocking_table()[i / bits].fetch_or(mask);
+			else
+				nonblocking_table()[i / bits].fetch_and(~mask);
+		}
+
+		static bool is_nonblocking(socket_type socket)
+		{
+			const unsigned bits(sizeof(unsigned long) * 8);
+			unsigned i(static_cast<unsigned>(socket));
+
+			if (socket < 0 || i / bits >= 1024)
+				return (::fcntl(socket, F_GETFL, 0) &
+							O_NONBLOCK) != 0;
+			return (nonblocking_table()[i / bits].load(std::
+					memory_order_relaxed) >> (i % bits) & 1) != 0;
+		}
+
+		static int dontwait(socket_type socket)
+		{
+			return is_nonblocking(socket) != false ? MSG_DONTWAIT : 0;
+		}
+
+		static std::streamsize completed(int res)
+		{
+			if (res < 0) {
+				errno = -res;
+				return -1;
+			}
+			return res;
+		}
+
+		static std::streamsize transfer(int op, socket_type socket,
+								msghdr* msg)
+		{
+			context& c(instance());
+			io_uring_sqe* sqe;
+			__u32 flags;
+
+			if (c.ring.is_open() == false ||
+					(sqe = c.ring.get_sqe()) == 0) {
+				if (op == IORING_OP_SENDMSG)
+					return ::sendmsg(socket, msg,
+							dontwait(socket));
+				return ::recvmsg(socket, msg, dontwait(socket));
+			}
+			sqe->opcode = static_cast<__u8>(op);
+			sqe->fd = socket;
+			sqe->msg_flags = dontwait(socket);
+			sqe->addr = reinterpret_cast<__u64>(msg);
+			sqe->len = 1;
+			return completed(c.complete(sqe, flags));
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,677 @@
+#ifndef SWOOPE_OPENSSL_SOCKET_TRAITS_HH
+#define SWOOPE_OPENSSL_SOCKET_TRAITS_HH
+
+/*
+ * openssl_socket_traits.hh
+ */
+
+#include "posix_native_socket_traits.hh"
+
+#include <cstring>
+#include <pthread.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+namespace swoope {
+
+	struct openssl_options {
+		/*
+		 * Context new client connections are made from, or 0 for one
+		 * that verifies servers against the system's trusted
+		 * certificates and host name
+		 */
+		SSL_CTX* client_context;
+
+		/*
+		 * Context accepted connections are made from, with the server's
+		 * certificate and key loaded. Must be set before accepting.
+		 */
+		SSL_CTX* server_context;
+
+		/*
+		 * Hand the session keys to the kernel after the handshake, so
+		 * that records are encrypted and decrypted there (kTLS)
+		 */
+		bool kernel_tls;
+
+		openssl_options() :
+		client_context(0),
+		server_context(0),
+		kernel_tls(true)
+		{
+		}
+	};
+
+	/*
+	 * Socket traits that run TLS over TCP with OpenSSL. open connects as
+	 * the native traits do, then completes the handshake before returning,
+	 * waiting for it even on a non-blocking socket. A failed handshake
+	 * closes the socket and sets errno to EPROTO. accept returns as soon
+	 * as the connection is accepted, and the server side of the handshake
+	 * runs within the first reads and writes on it.
+	 *
+	 * Where the kernel and OpenSSL support it, the session keys then move
+	 * into the kernel (TCP_ULP "tls"). Writes, write_more and send_file
+	 * go straight to send and sendfile on the socket, with no encryption
+	 * or copy in user space. Reads still go through SSL_read, which in
+	 * that case is a plain recvmsg that also handles the non-data records
+	 * a raw recv would fail on. Without kernel support, every byte goes
+	 * through SSL_read and SSL_write.
+	 *
+	 * Sockets that were not opened or accepted by these traits, such as
+	 * listeners, fall through to the native traits. Zero-copy sends and
+	 * splice are not available on TLS connections. Sessions are kept in a
+	 * table indexed by descriptor, without locking, for descriptors below
+	 * max_descriptor.
+	 */
+	struct openssl_socket_traits : native_socket_traits {
+
+		enum {
+			page_bits = 10,
+			page_count = 1024,
+			max_descriptor = page_count << page_bits
+		};
+
+		/* Contexts used for new connections */
+		static openssl_options& options()
+		{
+			static openssl_options result;
+			return result;
+		}
+
+		static socket_type open(const std::string& host,
+					const std::string& service)
+		{
+			return open(host, service, connect_options());
+		}
+
+		/* The handshake counts against options.timeout as well. */
+		static socket_type open(const std::string& host,
+					const std::string& service,
+					const connect_options& options)
+		{
+			long start(monotonic_time());
+			socket_type result((native_socket_traits::open(host,
+							service, options)));
+			int left(options.timeout);
+
+			if (result == invalid()) return result;
+			if (left >= 0) {
+				left -= static_cast<int>(monotonic_time() -
+									start);
+				if (left < 1) left = 1;
+			}
+			return secure(result, client_context(), &host, left);
+		}
+
+		static socket_type open(const std::string& service,
+							int backlog)
+		{
+			return native_socket_traits::open(service, backlog);
+		}
+
+		static socket_type open(const std::string& service,
+					int backlog,
+					const listener_options& options)
+		{
+			return native_socket_traits::open(service, backlog,
+								options);
+		}
+
+		static socket_type accept(socket_type sock)
+		{
+			address_type peer;
+
+			return accept(sock, peer, false);
+		}
+
+		/*
+		 * Does not wait for the handshake, so that a client that sends
+		 * nothing holds up only its own connection. Until the handshake
+		 * is done, reads and writes on a non-blocking socket fail with
+		 * EAGAIN, and the read and write time limits of a socketbuf
+		 * bound it. A failed handshake fails the first read or write
+		 * with EPROTO.
+		 */
+		static socket_type accept(socket_type sock, address_type& peer,
+							bool nonblocking)
+		{
+			socket_type result((native_socket_traits::accept(sock,
+							peer, nonblocking)));
+
+			if (result == invalid()) return result;
+			return secure(result, options().server_context, 0, -1);
+		}
+
+		static std::streamsize read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			connection* c(find(socket));
+			int got;
+
+			if (c == 0) return native_socket_traits::read(socket,
+								buf, n);
+			do {
+				ERR_clear_error();
+				got = ::SSL_read(c->ssl, buf, clamp(n));
+			} while (got <= 0 && interrupted(c->ssl, got));
+			return outcome(*c, got);
+		}
+
+		/*
+		 * Reads into buf1, then into buf2 as far as the records already
+		 * decrypted reach, without waiting for more.
+		 */
+		static std::streamsize read(socket_type socket,
+						void* buf1,
+						std::streamsize n1,
+						void* buf2,
+						std::streamsize n2)
+		{
+			connection* c(find(socket));
+			std::streamsize result;
+			int got;
+
+			if (c == 0) return native_socket_traits::read(socket,
+							buf1, n1, buf2, n2);
+			result = read(socket, buf1, n1);
+			if (result != n1 || n2 < 1 || ::SSL_pending(c->ssl) < 1)
+				return result;
+			ERR_clear_error();
+			got = ::SSL_read(c->ssl, buf2, std::min(clamp(n2),
+						::SSL_pending(c->ssl)));
+			return (got > 0) ? result + got : result;
+		}
+
+		static std::streamsize read_all(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			std::streamsize got(0), result(0);
+
+			if (find(socket) == 0)
+				return native_socket_traits::read_all(socket,
+								buf, n);
+			while (result < n) {
+				got = read(socket, static_cast<char*>(buf) +
+							result, n - result);
+				if (got <= 0) break;
+				result += got;
+			}
+			return (result == 0 && got < 0) ? -1 : result;
+		}
+
+		static int peek(socket_type socket)
+		{
+			connection* c(find(socket));
+			char b;
+			int got;
+
+			if (c == 0) return native_socket_traits::peek(socket);
+			do {
+				ERR_clear_error();
+				got = ::SSL_peek(c->ssl, &b, 1);
+			} while (got <= 0 && interrupted(c->ssl, got));
+			return static_cast<int>(outcome(*c, got));
+		}
+
+		/*
+		 * Reads only records already decrypted, since a record that
+		 * has partly arrived would make SSL_read wait for the rest.
+		 */
+		static std::streamsize try_read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			connection* c(find(socket));
+
+			if (c == 0) return native_socket_traits::try_read(socket,
+								buf, n);
+			if (::SSL_pending(c->ssl) < 1) {
+				errno = EAGAIN;
+				return -1;
+			}
+			return read(socket, buf, n);
+		}
+
+		static std::streamsize write(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			connection* c(find(socket));
+
+			if (c == 0 || c->offloaded != false)
+				return native_socket_traits::write(socket,
+								buf, n);
+			return send(*c, buf, n);
+		}
+
+		/*
+		 * Without kernel TLS, buf2 is only written once buf1 has been
+		 * written whole, so the write may be short.
+		 */
+		static std::streamsize write(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			connection* c(find(socket));
+
+			if (c == 0 || c->offloaded != false)
+				return native_socket_traits::write(socket,
+							buf1, n1, buf2, n2);
+			return send(*c, buf1, n1, buf2, n2);
+		}
+
+		static std::streamsize write_more(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			connection* c(find(socket));
+
+			if (c == 0 || c->offloaded != false)
+				return native_socket_traits::write_more(socket,
+								buf, n);
+			return send(*c, buf, n);
+		}
+
+		static std::streamsize write_more(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			connection* c(find(socket));
+
+			if (c == 0 || c->offloaded != false)
+				return native_socket_traits::write_more(socket,
+							buf1, n1, buf2, n2);
+			return send(*c, buf1, n1, buf2, n2);
+		}
+
+		/*
+		 * With kernel TLS the file goes out through sendfile and is
+		 * encrypted in the kernel. Otherwise it is read in record-sized
+		 * pieces and written with SSL_write.
+		 */
+		static std::streamsize send_file(socket_type socket, int fd,
+						off_t offset,
+						std::size_t length)
+		{
+			connection* c(find(socket));
+			char buf[16384];
+			ssize_t got;
+
+			if (c == 0 || c->offloaded != false)
+				return native_socket_traits::send_file(socket,
+							fd, offset, length);
+			got = ::pread(fd, buf, std::min(length, sizeof(buf)),
+								offset);
+			if (got <= 0) return got;
+			return send(*c, buf, got);
+		}
+
+		/* Not available on TLS connections. */
+		static int set_zerocopy(socket_type socket, bool on)
+		{
+			if (find(socket) == 0)
+				return native_socket_traits::set_zerocopy(socket,
+									on);
+			errno = ENOPROTOOPT;
+			return -1;
+		}
+
+		/* Not available on TLS connections. */
+		static std::streamsize splice(socket_type from, socket_type to,
+						int pipe[2], std::streamsize n,
+						std::streamsize& staged)
+		{
+			if (find(from) == 0 && find(to) == 0)
+				return native_socket_traits::splice(from, to,
+							pipe, n, staged);
+			errno = EOPNOTSUPP;
+			return -1;
+		}
+
+		/*
+		 * Shutting down output sends a close_notify alert before the
+		 * TCP FIN, so the peer reads a clean end of stream.
+		 */
+		static int shutdown(socket_type socket, std::ios_base::
+							openmode how)
+		{
+			connection* c(find(socket));
+
+			if (c != 0 && c->pending == false &&
+					(how & std::ios_base::out) != 0) {
+				ERR_clear_error();
+				::SSL_shutdown(c->ssl);
+			}
+			return native_socket_traits::shutdown(socket, how);
+		}
+
+		/* Sends close_notify if not sent yet, then closes the socket. */
+		static int close(socket_type socket)
+		{
+			connection* c(find(socket));
+
+			if (c != 0) {
+				ERR_clear_error();
+				if (c->pending == false && (::SSL_get_shutdown(
+						c->ssl) & SSL_SENT_SHUTDOWN) == 0)
+					::SSL_shutdown(c->ssl);
+				::SSL_free(c->ssl);
+				*c = connection();
+			}
+			return ::close(socket);
+		}
+
+		/*
+		 * Returns the directions, in and/or out, of socket's connection
+		 * that the kernel encrypts.
+		 */
+		static std::ios_base::openmode kernel_tls(socket_type socket)
+		{
+			std::ios_base::openmode result = std::ios_base::openmode();
+			connection* c(find(socket));
+
+			(void)c;
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+			if (c == 0 || c->pending != false) return result;
+			if (BIO_get_ktls_send(::SSL_get_wbio(c->ssl)))
+				result |= std::ios_base::out;
+			if (BIO_get_ktls_recv(::SSL_get_rbio(c->ssl)))
+				result |= std::ios_base::in;
+#endif
+			return result;
+		}
+
+		/* Returns the TLS session of socket, or 0 if it has none. */
+		static SSL* session(socket_type socket)
+		{
+			connection* c(find(socket));
+
+			return (c != 0) ? c->ssl : 0;
+		}
+	private:
+		struct connection {
+			SSL* ssl;
+			bool pending; /* server handshake not finished */
+			bool offloaded; /* kernel encrypts output */
+		};
+
+		/*
+		 * Sessions by descriptor, in pages of 1 << page_bits that are
+		 * allocated as needed and kept. Only the allocation of a page
+		 * is locked; a slot is used by whoever uses its socket.
+		 */
+		struct session_table {
+			pthread_mutex_t lock;
+			connection* pages[page_count];
+			SSL_CTX* client;
+		};
+
+		static session_table& table()
+		{
+			static session_table result = {
+				PTHREAD_MUTEX_INITIALIZER, { 0 }, 0
+			};
+
+			return result;
+		}
+
+		/* The configured client context, or the default one */
+		static SSL_CTX* client_context()
+		{
+			session_table& t(table());
+			SSL_CTX* result(options().client_context);
+
+			if (result != 0) return result;
+			::pthread_mutex_lock(&t.lock);
+			if (t.client == 0 && (t.client = ::SSL_CTX_new(
+						::TLS_client_method())) != 0) {
+				::SSL_CTX_set_default_verify_paths(t.client);
+				::SSL_CTX_set_verify(t.client, SSL_VERIFY_PEER,
+									0);
+			}
+			result = t.client;
+			::pthread_mutex_unlock(&t.lock);
+			return result;
+		}
+
+		/*
+		 * Returns the slot of socket, allocating its page if create is
+		 * true, or 0 if socket is out of range or has no page.
+		 */
+		static connection* slot(socket_type socket, bool create)
+		{
+			session_table& t(table());
+			unsigned i(static_cast<unsigned>(socket));
+			connection** page;
+			connection* p;
+
+			if (socket < 0 || socket >= max_descriptor) return 0;
+			page = &t.pages[i >> page_bits];
+			p = __atomic_load_n(page, __ATOMIC_ACQUIRE);
+			if (p == 0 && create != false) {
+				::pthread_mutex_lock(&t.lock);
+				if ((p = *page) == 0) {
+					p = new connection[1 << page_bits]();
+					__atomic_store_n(page, p, __ATOMIC_RELEASE);
+				}
+				::pthread_mutex_unlock(&t.lock);
+			}
+			return (p != 0) ? &p[i & ((1 << page_bits) - 1)] : 0;
+		}
+
+		/* Returns the session of socket, or 0 if it has none. */
+		static connection* find(socket_type socket)
+		{
+			connection* result(slot(socket, false));
+
+			return (result != 0 && result->ssl != 0) ? result : 0;
+		}
+
+		/* Notes whether the kernel took over once a handshake is done */
+		static void settle(connection& c)
+		{
+			if (c.pending == false ||
+					::SSL_is_init_finished(c.ssl) == 0)
+				return;
+			c.pending = false;
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+			c.offloaded = BIO_get_ktls_send(::SSL_get_wbio(c.ssl));
+#endif
+		}
+
+		/*
+		 * Starts a session on socket and files it away. As a client of
+		 * *host, completes the handshake within timeout milliseconds
+		 * (-1 for no limit). As a server, if host is 0, leaves it to the
+		 * first reads and writes. Closes socket and returns invalid() on
+		 * failure.
+		 */
+		static socket_type secure(socket_type socket, SSL_CTX* ctx,
+					const std::string* host, int timeout)
+		{
+			connection* c(slot(socket, true));
+			connection s = connection();
+			int error;
+
+			if (c == 0 || ctx == 0 || (s.ssl = ::SSL_new(ctx)) == 0) {
+				::close(socket);
+				errno = (c == 0) ? EMFILE : (ctx == 0) ? EINVAL :
+									ENOMEM;
+				return invalid();
+			}
+			::SSL_set_mode(s.ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+					SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#if defined(SSL_OP_ENABLE_KTLS)
+			if (options().kernel_tls != false)
+				::SSL_set_options(s.ssl, SSL_OP_ENABLE_KTLS);
+#endif
+			error = (::SSL_set_fd(s.ssl, socket) != 1);
+			if (host != 0) {
+				::SSL_set_connect_state(s.ssl);
+				if (error == 0 && host->empty() == false)
+					error = name(s.ssl, *host);
+				if (error == 0 &&
+					handshake(s.ssl, socket, timeout) != 0)
+					error = errno;
+				else if (error != 0)
+					error = EPROTO;
+			} else {
+				::SSL_set_accept_state(s.ssl);
+				s.pending = true;
+				if (error != 0) error = EPROTO;
+			}
+			if (error != 0) {
+				::SSL_free(s.ssl);
+				::close(socket);
+				errno = error;
+				return invalid();
+			}
+			*c = s;
+			settle(*c);
+			return socket;
+		}
+
+		/*
+		 * Names the server for SNI and certificate checks. Address
+		 * literals are matched against IP addresses in the certificate
+		 * instead. Returns 0 on success.
+		 */
+		static int name(SSL* ssl, const std::string& host)
+		{
+			unsigned char ip[16];
+
+			if (::inet_pton(AF_INET, host.c_str(), ip) == 1 ||
+				::inet_pton(AF_INET6, host.c_str(), ip) == 1)
+				return ::X509_VERIFY_PARAM_set1_ip_asc(
+					::SSL_get0_param(ssl), host.c_str()) == 1 ?
+									0 : -1;
+			if (::SSL_set_tlsext_host_name(ssl, host.c_str()) != 1 ||
+					::SSL_set1_host(ssl, host.c_str()) != 1)
+				return -1;
+			return 0;
+		}
+
+		/*
+		 * Completes the handshake, polling the socket whenever it is
+		 * not ready, for at most timeout milliseconds (-1 for no
+		 * limit). Returns 0 on success.
+		 */
+		static int handshake(SSL* ssl, socket_type socket, int timeout)
+		{
+			long deadline(timeout < 0 ? -1 :
+					monotonic_time() + timeout);
+			pollfd pfd;
+			int ret, left(-1);
+
+			for (;;) {
+				ERR_clear_error();
+				ret = ::SSL_do_handshake(ssl);
+				if (ret == 1) return 0;
+				switch (::SSL_get_error(ssl, ret)) {
+				case SSL_ERROR_WANT_READ:
+					pfd.events = POLLIN;
+					break;
+				case SSL_ERROR_WANT_WRITE:
+					pfd.events = POLLOUT;
+					break;
+				case SSL_ERROR_SYSCALL:
+					if (errno == EINTR) continue;
+					if (errno == 0) errno = ECONNRESET;
+					return -1;
+				default:
+					errno = EPROTO;
+					return -1;
+				}
+				if (deadline != -1) {
+					left = static_cast<int>(deadline -
+							monotonic_time());
+					if (left <= 0) {
+						errno = ETIMEDOUT;
+						return -1;
+					}
+				}
+				pfd.fd = socket;
+				pfd.revents = 0;
+				if (::poll(&pfd, 1, left) < 0 && errno != EINTR)
+					return -1;
+			}
+		}
+
+		static std::streamsize send(connection& c, const void* buf,
+							std::streamsize n)
+		{
+			int put;
+
+			if (n < 1) return 0;
+			do {
+				ERR_clear_error();
+				put = ::SSL_write(c.ssl, buf, clamp(n));
+			} while (put <= 0 && interrupted(c.ssl, put));
+			return outcome(c, put);
+		}
+
+		static std::streamsize send(connection& c, const void* buf1,
+							std::streamsize n1,
+							const void* buf2,
+							std::streamsize n2)
+		{
+			std::streamsize result((send(c, buf1, n1))), put;
+
+			if (result != n1 || n2 < 1) return result;
+			put = send(c, buf2, n2);
+			/* The error comes back with the next write */
+			return (put > 0) ? result + put : result;
+		}
+
+		static int clamp(std::streamsize n)
+		{
+			return static_cast<int>(std::min(n,
+				static_cast<std::streamsize>(0x7fffffff)));
+		}
+
+		static bool interrupted(SSL* ssl, int ret)
+		{
+			return ::SSL_get_error(ssl, ret) == SSL_ERROR_SYSCALL &&
+								errno == EINTR;
+		}
+
+		/*
+		 * Turns the result of an SSL call into what the native traits
+		 * would have returned: 0 at close_notify, and -1 with errno set
+		 * so that would_block() and timed_out() keep working.
+		 */
+		static std::streamsize outcome(connection& c, int ret)
+		{
+			int error(ret > 0 ? SSL_ERROR_NONE :
+					::SSL_get_error(c.ssl, ret));
+
+			settle(c);
+			if (ret > 0) return ret;
+			switch (error) {
+			case SSL_ERROR_ZERO_RETURN:
+				return 0;
+			case SSL_ERROR_WANT_READ:
+			case SSL_ERROR_WANT_WRITE:
+				errno = EAGAIN;
+				return -1;
+			case SSL_ERROR_SYSCALL:
+				if (errno == 0) errno = ECONNRESET;
+				return -1;
+			default:
+				errno = EPROTO;
+				return -1;
+			}
+		}
+	};
+
+}
+
+#endif
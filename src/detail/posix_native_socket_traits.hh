@@ -7,19 +7,43 @@
  * Date: July 2017
  */
 #include <iostream>
+#include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#include <linux/filter.h>
+#endif
 
+#include <algorithm>
+#include <cstring>
 #include <ios>
 #include <string>
+#include <vector>
+#include "../connect_options.hh"
+#include "../datagram.hh"
+#include "../endpoint.hh"
+#if __cplusplus >= 201103L
+#include "../resolver_cache.hh"
+#endif
+#include "../listener_options.hh"
 
 namespace swoope {
 
 	struct native_socket_traits {
 		typedef int socket_type;
+		typedef sockaddr_storage address_type;
 	
 		static socket_type invalid()
 		{
@@ -29,28 +53,53 @@ namespace swoope {
 		static socket_type open(const std::string& host,
 					const std::string& service)
 		{
-			using std::swap;
+			return open(host, service, connect_options());
+		}
+
+		/*
+		 * Connects to any address of host, racing the addresses with
+		 * staggered non-blocking connects. The socket that connects first
+		 * is returned in blocking mode.
+		 */
+		static socket_type open(const std::string& host,
+					const std::string& service,
+					const connect_options& options)
+		{
 			addrinfo *ai, hints = addrinfo();
-			socket_type result((invalid()));
+			std::vector<const addrinfo*> order;
+			socket_type result;
+
+#if __cplusplus >= 201103L
+			if (options.resolver != 0) {
+				resolver_cache::result_type r((options.resolver->
+						resolve(host, service)));
 
+				if (!r) return invalid();
+				interleave(r.get(), order);
+				return race(order, options);
+			}
+#endif
 			hints.ai_family = AF_UNSPEC;
 			hints.ai_socktype = SOCK_STREAM;
 			hints.ai_protocol = IPPROTO_TCP;
 			if (::getaddrinfo(host.c_str(), service.c_str(),
 							&hints, &ai) != 0)
-				return result;
-			socket_type socket((::socket(ai->ai_family,
-							ai->ai_socktype,
-							ai->ai_protocol)));
-			if (socket != result && ::connect(socket, ai->ai_addr,
-							ai->ai_addrlen) == 0)
-				swap(result, socket);
+				return invalid();
+			interleave(ai, order);
+			result = race(order, options);
 			::freeaddrinfo(ai);
 			return result;
 		}
 
 		static socket_type open(const std::string& service,
 							int backlog)
+		{
+			return open(service, backlog, listener_options());
+		}
+
+		static socket_type open(const std::string& service,
+					int backlog,
+					const listener_options& options)
 		{
 			using std::swap;
 			addrinfo *ai, hints = addrinfo();
@@ -67,12 +116,18 @@ namespace swoope {
 			socket_type socket((::socket(ai->ai_family,
 							ai->ai_socktype,
 							ai->ai_protocol)));
-			if (socket == result) return result;
+			if (socket == result) {
+				::freeaddrinfo(ai);
+				return result;
+			}
 			if (::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR,
 					&optval, sizeof(optval)) != 0 ||
+					set_listener_options(socket,
+							options) != 0 ||
 					::bind(socket, ai->ai_addr,
 					ai->ai_addrlen) != 0 ||
-					::listen(socket, backlog) != 0) {
+					::listen(socket, backlog) != 0 ||
+					steer_by_cpu(socket, options) != 0) {
 				close(socket);
 				socket = result;
 			}
@@ -85,9 +140,423 @@ namespace swoope {
 		{
 			return ::accept(sock, 0, 0);
 		}
+
+		/*
+		 * Accepts a connection and stores the peer's address in peer. The
+		 * new socket is close-on-exec, and starts out non-blocking if
+		 * nonblocking is true, with a single accept4 call where available.
+		 */
+		static socket_type accept(socket_type sock, address_type& peer,
+							bool nonblocking)
+		{
+			socklen_t len(sizeof(peer));
+#if defined(__linux__)
+			return ::accept4(sock, (sockaddr*)&peer, &len,
+				SOCK_CLOEXEC | (nonblocking ? SOCK_NONBLOCK : 0));
+#else
+			socket_type result((::accept(sock, (sockaddr*)&peer,
+								&len)));
+
+			if (result == invalid()) return result;
+			if (::fcntl(result, F_SETFD, FD_CLOEXEC) == -1 ||
+				(nonblocking != false &&
+				set_blocking(result, false) != 0)) {
+				close(result);
+				result = invalid();
+			}
+			return result;
+#endif
+		}
 	private:
+		/* Orders addresses by alternating families, first one's first */
+		static void interleave(const addrinfo* ai,
+					std::vector<const addrinfo*>& order)
+		{
+			std::vector<const addrinfo*> first, other;
+
+			for (; ai != 0; ai = ai->ai_next) {
+				if (first.empty() != false ||
+					ai->ai_family == first[0]->ai_family)
+					first.push_back(ai);
+				else
+					other.push_back(ai);
+			}
+			for (std::size_t i = 0; i < first.size() ||
+						i < other.size(); ++i) {
+				if (i < first.size()) order.push_back(first[i]);
+				if (i < other.size()) order.push_back(other[i]);
+			}
+		}
+
+		/* A datagram as a msghdr, with room for its address and cmsg */
+		struct message_type {
+			msghdr msg;
+			iovec iov;
+			address_type address;
+			union {
+				std::size_t align; /* as CMSG_ALIGN assumes */
+				char buf[CMSG_SPACE(sizeof(int)) * 2];
+			} control;
+
+			int prepare_send(const datagram& d)
+			{
+				cmsghdr* cm;
+
+				msg = msghdr();
+				iov.iov_base = d.data;
+				iov.iov_len = d.size;
+				msg.msg_iov = &iov;
+				msg.msg_iovlen = 1;
+				if (d.peer.empty() == false) {
+					msg.msg_name = &address;
+					msg.msg_namelen = to_address(d.peer, address);
+				}
+				if (d.segment_size == 0) return 0;
+#if defined(UDP_SEGMENT)
+				uint16_t segment(static_cast<uint16_t>(
+							d.segment_size));
+
+				std::memset(&control, 0, sizeof(control));
+				msg.msg_control = control.buf;
+				msg.msg_controllen = CMSG_SPACE(sizeof(segment));
+				cm = CMSG_FIRSTHDR(&msg);
+				cm->cmsg_level = IPPROTO_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(segment));
+				std::memcpy(CMSG_DATA(cm), &segment,
+							sizeof(segment));
+				return 0;
+#else
+				(void)cm;
+				errno = EOPNOTSUPP;
+				return -1;
+#endif
+			}
+
+			void prepare_receive(datagram& d)
+			{
+				msg = msghdr();
+				iov.iov_base = d.data;
+				iov.iov_len = d.capacity;
+				msg.msg_iov = &iov;
+				msg.msg_iovlen = 1;
+				msg.msg_name = &address;
+				msg.msg_namelen = sizeof(address);
+				msg.msg_control = control.buf;
+				msg.msg_controllen = sizeof(control.buf);
+			}
+
+			void finish_receive(datagram& d, std::size_t n)
+			{
+				cmsghdr* cm;
+				int segment;
+
+				d.size = n;
+				d.peer = (msg.msg_namelen != 0) ?
+					to_endpoint(address) : endpoint();
+				d.segment_size = 0;
+				d.truncated = (msg.msg_flags & MSG_TRUNC) != 0;
+				for (cm = CMSG_FIRSTHDR(&msg); cm != 0;
+						cm = CMSG_NXTHDR(&msg, cm)) {
+#if defined(UDP_GRO)
+					if (cm->cmsg_level == IPPROTO_UDP &&
+						cm->cmsg_type == UDP_GRO) {
+						std::memcpy(&segment, CMSG_DATA(cm),
+							sizeof(segment));
+						d.segment_size = static_cast<
+							std::size_t>(segment);
+					}
+#else
+					(void)segment;
+#endif
+				}
+			}
+		};
+
+		static int send_prepared(socket_type socket, message_type* msgs,
+								int n)
+		{
+			int result;
+#if defined(__linux__)
+			mmsghdr v[datagram_batch];
+
+			for (int i = 0; i < n; ++i) {
+				v[i].msg_hdr = msgs[i].msg;
+				v[i].msg_len = 0;
+			}
+			do {
+				result = ::sendmmsg(socket, v, n, 0);
+			} while (result == -1 && errno == EINTR);
+#else
+			for (result = 0; result < n; ++result)
+				if (::sendmsg(socket, &msgs[result].msg, 0) < 0)
+					break;
+			if (result == 0) result = -1;
+#endif
+			return result;
+		}
+
+		static int more_flag()
+		{
+#if defined(MSG_MORE)
+			return MSG_MORE;
+#else
+			return 0;
+#endif
+		}
+
+		static time_t monotonic_seconds()
+		{
+			timespec ts;
+
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+			return ts.tv_sec;
+		}
+
+		/*
+		 * Starts a non-blocking connect to ai. Returns the socket, or
+		 * invalid() if the attempt failed at once. connected is set if it
+		 * completed at once.
+		 */
+		static socket_type start_connect(const addrinfo* ai,
+					const connect_options& options,
+					bool& connected)
+		{
+			socket_type result((::socket(ai->ai_family,
+							ai->ai_socktype,
+							ai->ai_protocol)));
+
+			connected = false;
+			if (result == invalid()) return result;
+			if (set_options(result, options.socket_options) != 0 ||
+					set_blocking(result, false) != 0) {
+				close(result);
+				return invalid();
+			}
+			if (::connect(result, ai->ai_addr, ai->ai_addrlen) == 0) {
+				connected = true;
+			} else if (errno != EINPROGRESS) {
+				int error(errno);
+
+				close(result);
+				errno = error;
+				result = invalid();
+			}
+			return result;
+		}
+
+		static socket_type race(
+					const std::vector<const addrinfo*>& order,
+					const connect_options& options)
+		{
+			std::vector<pollfd> pending;
+			std::size_t next(0), i;
+			long deadline(-1), start_next(0), left;
+			socket_type result((invalid())), s;
+			int error(ECONNREFUSED), wait, err;
+			socklen_t len;
+			bool connected;
+
+			if (options.timeout >= 0)
+				deadline = monotonic_time() + options.timeout;
+			while (result == invalid()) {
+				if (next < order.size() &&
+						(pending.empty() != false ||
+						monotonic_time() >= start_next)) {
+					s = start_connect(order[next++], options,
+								connected);
+					if (s == invalid()) {
+						error = errno;
+						continue;
+					}
+					if (connected != false) {
+						result = s;
+						break;
+					}
+					pollfd p = { s, POLLOUT, 0 };
+					pending.push_back(p);
+					start_next = monotonic_time() +
+							options.attempt_delay;
+				}
+				if (pending.empty() != false) break;
+				wait = -1;
+				if (next < order.size())
+					wait = static_cast<int>(std::max(
+						start_next - monotonic_time(), 0L));
+				if (deadline != -1) {
+					if ((left = deadline - monotonic_time()) <= 0) {
+						error = ETIMEDOUT;
+						break;
+					}
+					if (wait == -1 || left < wait)
+						wait = static_cast<int>(left);
+				}
+				if (::poll(&pending[0], pending.size(), wait) < 0 &&
+							errno != EINTR) {
+					error = errno;
+					break;
+				}
+				for (i = 0; i < pending.size(); ) {
+					if (pending[i].revents == 0) {
+						++i;
+						continue;
+					}
+					len = sizeof(err);
+					if (::getsockopt(pending[i].fd, SOL_SOCKET,
+						SO_ERROR, &err, &len) != 0)
+						err = errno;
+					if (err == 0 && result == invalid()) {
+						result = pending[i].fd;
+					} else {
+						if (err != 0) error = err;
+						close(pending[i].fd);
+						/* A failed attempt lets the next start */
+						start_next = monotonic_time();
+					}
+					pending.erase(pending.begin() + i);
+				}
+			}
+			for (i = 0; i < pending.size(); ++i)
+				close(pending[i].fd);
+			if (result != invalid() && set_blocking(result, true) != 0) {
+				error = errno;
+				close(result);
+				result = invalid();
+			}
+			if (result == invalid()) errno = error;
+			return result;
+		}
+
+		static int set_options(socket_type socket,
+				const std::vector<socket_option>& options)
+		{
+			for (std::size_t i = 0; i < options.size(); ++i)
+				if (set_option(socket, options[i]) != 0)
+					return -1;
+			return 0;
+		}
+
+		/* Finds the level and option of name. Returns -1 if unknown. */
+		static int option_name(socket_option::name_type name,
+						int& level, int& option)
+		{
+			level = IPPROTO_TCP;
+			switch (name) {
+			case socket_option::nodelay:
+				option = TCP_NODELAY;
+				return 0;
+#if defined(TCP_QUICKACK)
+			case socket_option::quickack:
+				option = TCP_QUICKACK;
+				return 0;
+#endif
+#if defined(TCP_USER_TIMEOUT)
+			case socket_option::user_timeout:
+				option = TCP_USER_TIMEOUT;
+				return 0;
+#endif
+#if defined(TCP_KEEPIDLE)
+			case socket_option::keepalive_idle:
+				option = TCP_KEEPIDLE;
+				return 0;
+#elif defined(TCP_KEEPALIVE)
+			case socket_option::keepalive_idle:
+				option = TCP_KEEPALIVE;
+				return 0;
+#endif
+#if defined(TCP_KEEPINTVL)
+			case socket_option::keepalive_interval:
+				option = TCP_KEEPINTVL;
+				return 0;
+#endif
+#if defined(TCP_KEEPCNT)
+			case socket_option::keepalive_count:
+				option = TCP_KEEPCNT;
+				return 0;
+#endif
+			default:
+				break;
+			}
+			level = SOL_SOCKET;
+			switch (name) {
+			case socket_option::send_buffer:
+				option = SO_SNDBUF;
+				return 0;
+			case socket_option::receive_buffer:
+				option = SO_RCVBUF;
+				return 0;
+#if defined(SO_PRIORITY)
+			case socket_option::priority:
+				option = SO_PRIORITY;
+				return 0;
+#endif
+			case socket_option::keepalive:
+				option = SO_KEEPALIVE;
+				return 0;
+			default:
+				return -1;
+			}
+		}
+
+		static int set_listener_options(socket_type socket,
+					const listener_options& options)
+		{
+			int optval = 1;
+
+			if (set_options(socket, options.socket_options) != 0)
+				return -1;
+
+			if (options.reuse_port != false) {
+#if defined(SO_REUSEPORT)
+				if (::setsockopt(socket, SOL_SOCKET, SO_REUSEPORT,
+						&optval, sizeof(optval)) != 0)
+					return -1;
+#else
+				return -1;
+#endif
+			}
+			if (options.incoming_cpu != -1) {
+#if defined(SO_INCOMING_CPU)
+				optval = options.incoming_cpu;
+				if (::setsockopt(socket, SOL_SOCKET,
+						SO_INCOMING_CPU, &optval,
+						sizeof(optval)) != 0)
+					return -1;
+#else
+				return -1;
+#endif
+			}
+			return 0;
+		}
+
+		/*
+		 * Selects the listener of the reuseport group by the number of
+		 * the CPU that received the connection. The kernel falls back to
+		 * hashing if there are fewer listeners than CPUs.
+		 */
+		static int steer_by_cpu(socket_type socket,
+					const listener_options& options)
+		{
+			if (options.steer_by_cpu == false) return 0;
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+			sock_filter code[] = {
+				{ BPF_LD | BPF_W | BPF_ABS, 0, 0,
+					static_cast<__u32>(SKF_AD_OFF +
+							SKF_AD_CPU) },
+				{ BPF_RET | BPF_A, 0, 0, 0 }
+			};
+			sock_fprog prog = { 2, code };
+
+			return ::setsockopt(socket, SOL_SOCKET,
+					SO_ATTACH_REUSEPORT_CBPF, &prog,
+					sizeof(prog));
+#else
+			return -1;
+#endif
+		}
+
 		static std::string sockaddr_storage_to_string(
-					sockaddr_storage *ss)
+					const sockaddr_storage *ss)
 		{
 			std::string result;
 			socklen_t sslen(sizeof(*ss));
@@ -126,6 +595,49 @@ namespace swoope {
 			return sockaddr_storage_to_string(&ss);
 		}
 
+		/* Converts an address returned by accept to an endpoint */
+		static endpoint to_endpoint(const address_type& address)
+		{
+			const sockaddr_in* in4;
+			const sockaddr_in6* in6;
+
+			switch (address.ss_family) {
+			case AF_INET:
+				in4 = (const sockaddr_in*)&address;
+				return endpoint(endpoint::ipv4,
+					(const unsigned char*)&in4->sin_addr,
+					ntohs(in4->sin_port));
+			case AF_INET6:
+				in6 = (const sockaddr_in6*)&address;
+				return endpoint(endpoint::ipv6,
+					(const unsigned char*)&in6->sin6_addr,
+					ntohs(in6->sin6_port),
+					in6->sin6_scope_id);
+			default:
+				return endpoint();
+			}
+		}
+
+		static endpoint local_endpoint(socket_type sock)
+		{
+			address_type ss;
+			socklen_t sl = sizeof(ss);
+
+			if (::getsockname(sock, (sockaddr*)&ss, &sl) != 0)
+				return endpoint();
+			return to_endpoint(ss);
+		}
+
+		static endpoint remote_endpoint(socket_type sock)
+		{
+			address_type ss;
+			socklen_t sl = sizeof(ss);
+
+			if (::getpeername(sock, (sockaddr*)&ss, &sl) != 0)
+				return endpoint();
+			return to_endpoint(ss);
+		}
+
 		static std::streamsize read(socket_type socket,
 						void* buf,
 						std::streamsize n)
@@ -133,6 +645,81 @@ namespace swoope {
 			return ::recv(socket, buf, n, 0);
 		}
 
+		/*
+		 * Receive exactly n bytes unless the peer shuts down or an error
+		 * occurs. Returns the number of bytes received, or -1 if an
+		 * error occurred before anything was received.
+		 */
+		static std::streamsize read_all(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			std::streamsize got(0), result(0);
+
+			while (result < n) {
+				got = ::recv(socket, static_cast<char*>(buf) +
+						result, n - result, MSG_WAITALL);
+				if (got < 0 && errno == EINTR) continue;
+				if (got <= 0) break;
+				result += got;
+			}
+			return (result == 0 && got < 0) ? -1 : result;
+		}
+
+		/*
+		 * Waits until input is available without consuming it. Returns 1
+		 * if there is input, 0 if the peer has shut down, or -1 on error.
+		 */
+		static int peek(socket_type socket)
+		{
+			char c;
+			ssize_t got;
+
+			do {
+				got = ::recv(socket, &c, 1, MSG_PEEK);
+			} while (got < 0 && errno == EINTR);
+			return static_cast<int>(got);
+		}
+
+		/*
+		 * Reads what is already queued, without waiting even if the
+		 * socket is blocking. Returns -1 with would_block() set if
+		 * nothing is.
+		 */
+		static std::streamsize try_read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			ssize_t got;
+
+			do {
+				got = ::recv(socket, buf, n, MSG_DONTWAIT);
+			} while (got < 0 && errno == EINTR);
+			return got;
+		}
+
+		/*
+		 * Scatter-read into buf1 and then buf2 with a single system call.
+		 * Returns the total number of bytes received.
+		 */
+		static std::streamsize read(socket_type socket,
+						void* buf1,
+						std::streamsize n1,
+						void* buf2,
+						std::streamsize n2)
+		{
+			msghdr msg = msghdr();
+			iovec iov[2];
+
+			iov[0].iov_base = buf1;
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = buf2;
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+			return ::recvmsg(socket, &msg, 0);
+		}
+
 		static std::streamsize write(socket_type socket,
 						const void* buf,
 						std::streamsize n)
@@ -140,6 +727,386 @@ namespace swoope {
 			return ::send(socket, buf, n, 0);
 		}
 
+		/*
+		 * Gather-write buf1 followed by buf2 with a single system call.
+		 * Returns the total number of bytes sent, which may be short.
+		 */
+		static std::streamsize write(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			msghdr msg = msghdr();
+			iovec iov[2];
+
+			iov[0].iov_base = const_cast<void*>(buf1);
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = const_cast<void*>(buf2);
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+			return ::sendmsg(socket, &msg, 0);
+		}
+
+		/*
+		 * Same as write, telling the system that more data follows so that
+		 * it holds back a partial segment (MSG_MORE) where it can.
+		 */
+		static std::streamsize write_more(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			return ::send(socket, buf, n, more_flag());
+		}
+
+		static std::streamsize write_more(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			msghdr msg = msghdr();
+			iovec iov[2];
+
+			iov[0].iov_base = const_cast<void*>(buf1);
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = const_cast<void*>(buf2);
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = 2;
+			return ::sendmsg(socket, &msg, more_flag());
+		}
+
+		/*
+		 * Returns a monotonic time in milliseconds, counted from the
+		 * first call so that a 32-bit long lasts for weeks.
+		 */
+		static long monotonic_time()
+		{
+			static const time_t origin(monotonic_seconds());
+			timespec ts;
+
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<long>(ts.tv_sec - origin) * 1000L +
+						ts.tv_nsec / 1000000L;
+		}
+
+		/*
+		 * Sends up to length bytes of file descriptor fd starting at offset
+		 * without copying them through user space. Returns the number of
+		 * bytes sent, 0 at end of file, or -1 on error.
+		 */
+		static std::streamsize send_file(socket_type socket, int fd,
+						off_t offset,
+						std::size_t length)
+		{
+#if defined(__linux__)
+			return ::sendfile(socket, fd, &offset, length);
+#elif defined(__APPLE__)
+			off_t len((static_cast<off_t>(length)));
+
+			if (::sendfile(fd, socket, offset, &len, 0, 0) == -1 &&
+								len == 0)
+				return -1;
+			return static_cast<std::streamsize>(len);
+#else
+			char buf[BUFSIZ];
+			ssize_t got((::pread(fd, buf, length < sizeof(buf) ?
+					length : sizeof(buf), offset)));
+
+			if (got <= 0) return got;
+			return ::send(socket, buf, got, 0);
+#endif
+		}
+
+		/*
+		 * Creates the pipe that splice stages data in. Returns 0 on
+		 * success.
+		 */
+		static int open_pipe(int pipe[2])
+		{
+#if defined(__linux__)
+			return ::pipe2(pipe, O_CLOEXEC);
+#else
+			return ::pipe(pipe);
+#endif
+		}
+
+		static void close_pipe(int pipe[2])
+		{
+			if (pipe[0] != -1) ::close(pipe[0]);
+			if (pipe[1] != -1) ::close(pipe[1]);
+			pipe[0] = pipe[1] = -1;
+		}
+
+		/*
+		 * Moves up to n bytes received on from to socket to, inside the
+		 * kernel where possible, staging them in pipe. staged counts the
+		 * bytes left in pipe by a call that could not send them all; they
+		 * are sent before anything new is received. Returns the number of
+		 * bytes moved, 0 at end of stream, or -1 on error.
+		 */
+		static std::streamsize splice(socket_type from, socket_type to,
+						int pipe[2], std::streamsize n,
+						std::streamsize& staged)
+		{
+#if defined(__linux__)
+			std::streamsize result(0);
+			ssize_t got, put;
+
+			if (staged == 0) {
+				do {
+					got = ::splice(from, 0, pipe[1], 0, n,
+							SPLICE_F_MOVE);
+				} while (got < 0 && errno == EINTR);
+				if (got <= 0) return got;
+				staged = got;
+			}
+			while (staged > 0) {
+				put = ::splice(pipe[0], 0, to, 0, staged,
+							SPLICE_F_MOVE);
+				if (put < 0 && errno == EINTR) continue;
+				if (put <= 0) return result > 0 ? result : -1;
+				staged -= put;
+				result += put;
+			}
+			return result;
+#else
+			char buf[BUFSIZ];
+			ssize_t got, put(0), moved;
+
+			if (staged == 0) {
+				got = ::recv(from, buf, n < static_cast<
+					std::streamsize>(sizeof(buf)) ? n :
+							sizeof(buf), 0);
+				if (got <= 0) return got;
+			} else {
+				/* staged never exceeds buf, so this empties pipe */
+				do {
+					got = ::read(pipe[0], buf, staged);
+				} while (got < 0 && errno == EINTR);
+				if (got != staged) return -1;
+				staged = 0;
+			}
+			for (moved = 0; moved < got; moved += put) {
+				put = ::send(to, buf + moved, got - moved, 0);
+				if (put < 0 && errno == EINTR) {
+					put = 0;
+					continue;
+				}
+				if (put > 0) continue;
+				/* The unsent tail waits in pipe for the next call */
+				if (::write(pipe[1], buf + moved, got - moved) !=
+								got - moved)
+					return -1;
+				staged = got - moved;
+				return moved > 0 ? moved : -1;
+			}
+			return got;
+#endif
+		}
+
+		/* Most datagrams send_datagrams and receive_datagrams handle per call */
+		enum { datagram_batch = 64 };
+
+		/*
+		 * Opens a UDP socket. With a host, the socket is connected to the
+		 * first address of host and service. Otherwise it is bound to
+		 * service on the first local address, IPv4 or IPv6, that
+		 * getaddrinfo offers.
+		 */
+		static socket_type open_datagram(const std::string& host,
+						const std::string& service)
+		{
+			addrinfo *ai, hints = addrinfo();
+			socket_type result;
+			int error;
+
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_DGRAM;
+			hints.ai_protocol = IPPROTO_UDP;
+			if (host.empty() != false) hints.ai_flags |= AI_PASSIVE;
+			if (::getaddrinfo(host.empty() != false ? 0 : host.c_str(),
+					service.c_str(), &hints, &ai) != 0)
+				return invalid();
+			result = ::socket(ai->ai_family, ai->ai_socktype,
+							ai->ai_protocol);
+			if (result != invalid() &&
+				(::fcntl(result, F_SETFD, FD_CLOEXEC) == -1 ||
+				(host.empty() != false ?
+				::bind(result, ai->ai_addr, ai->ai_addrlen) :
+				::connect(result, ai->ai_addr,
+						ai->ai_addrlen)) != 0)) {
+				error = errno;
+				close(result);
+				errno = error;
+				result = invalid();
+			}
+			::freeaddrinfo(ai);
+			return result;
+		}
+
+		/*
+		 * Converts e to a socket address. Returns the length of the
+		 * address, or 0 if e is empty.
+		 */
+		static socklen_t to_address(const endpoint& e,
+						address_type& address)
+		{
+			sockaddr_in* in4;
+			sockaddr_in6* in6;
+
+			std::memset(&address, 0, sizeof(address));
+			switch (e.family()) {
+			case endpoint::ipv4:
+				in4 = (sockaddr_in*)&address;
+				in4->sin_family = AF_INET;
+				in4->sin_port = htons(e.port());
+				std::memcpy(&in4->sin_addr, e.address(), 4);
+				return sizeof(*in4);
+			case endpoint::ipv6:
+				in6 = (sockaddr_in6*)&address;
+				in6->sin6_family = AF_INET6;
+				in6->sin6_port = htons(e.port());
+				in6->sin6_scope_id = static_cast<uint32_t>(
+								e.scope_id());
+				std::memcpy(&in6->sin6_addr, e.address(), 16);
+				return sizeof(*in6);
+			default:
+				return 0;
+			}
+		}
+
+		/*
+		 * Sends up to datagram_batch of the count datagrams, with one
+		 * sendmmsg call where available. Returns how many were sent, or
+		 * -1 if not even the first was.
+		 */
+		static int send_datagrams(socket_type socket, const datagram* d,
+							std::size_t count)
+		{
+			int n(static_cast<int>(std::min(count,
+				static_cast<std::size_t>(datagram_batch))));
+			message_type msgs[datagram_batch];
+
+			for (int i = 0; i < n; ++i) {
+				if (msgs[i].prepare_send(d[i]) != 0) {
+					/* Send the ones before it on their own */
+					if (i == 0) return -1;
+					n = i;
+				}
+			}
+			return send_prepared(socket, msgs, n);
+		}
+
+		/*
+		 * Receives up to datagram_batch of count datagrams into their
+		 * buffers, with one recvmmsg call where available. If wait is
+		 * true, a blocking socket waits for the first datagram, otherwise
+		 * only datagrams already queued are taken. Returns how many were
+		 * received, or -1 if none was.
+		 */
+		static int receive_datagrams(socket_type socket, datagram* d,
+						std::size_t count, bool wait)
+		{
+			int n(static_cast<int>(std::min(count,
+				static_cast<std::size_t>(datagram_batch))));
+			message_type msgs[datagram_batch];
+			int result;
+
+			for (int i = 0; i < n; ++i) msgs[i].prepare_receive(d[i]);
+#if defined(__linux__)
+			mmsghdr v[datagram_batch];
+
+			for (int i = 0; i < n; ++i) {
+				v[i].msg_hdr = msgs[i].msg;
+				v[i].msg_len = 0;
+			}
+			do {
+				result = ::recvmmsg(socket, v, n, wait != false ?
+					MSG_WAITFORONE : MSG_DONTWAIT, 0);
+			} while (result == -1 && errno == EINTR);
+			for (int i = 0; i < result; ++i) {
+				msgs[i].msg = v[i].msg_hdr;
+				msgs[i].finish_receive(d[i], v[i].msg_len);
+			}
+#else
+			ssize_t got;
+
+			for (result = 0; result < n; ++result) {
+				got = ::recvmsg(socket, &msgs[result].msg,
+					(wait != false && result == 0) ? 0 :
+								MSG_DONTWAIT);
+				if (got < 0) break;
+				msgs[result].finish_receive(d[result],
+						static_cast<std::size_t>(got));
+			}
+			if (result == 0) result = -1;
+#endif
+			return result;
+		}
+
+		/*
+		 * Makes the socket receive datagrams the kernel coalesced from
+		 * consecutive packets of one flow (UDP GRO). Returns 0 on
+		 * success.
+		 */
+		static int set_gro(socket_type socket, bool on)
+		{
+#if defined(UDP_GRO)
+			int optval((on != false) ? 1 : 0);
+
+			return ::setsockopt(socket, IPPROTO_UDP, UDP_GRO, &optval,
+							sizeof(optval));
+#else
+			(void)socket;
+			(void)on;
+			errno = ENOPROTOOPT;
+			return -1;
+#endif
+		}
+
+		/*
+		 * Waits up to timeout milliseconds (-1 for no limit) until one of
+		 * count sockets is ready for the input and/or output given in
+		 * events, and stores what each one is ready for in ready. Hangups
+		 * and errors count as ready for both. Returns the number of ready
+		 * sockets, 0 on timeout, or -1 on error.
+		 */
+		static int poll(const socket_type* sockets,
+					const std::ios_base::openmode* events,
+					std::ios_base::openmode* ready,
+					int count, int timeout)
+		{
+			pollfd pfds[16];
+			int result;
+
+			if (count < 0 || count > 16) return -1;
+			for (int i = 0; i < count; ++i) {
+				pfds[i].fd = sockets[i];
+				pfds[i].events = 0;
+				pfds[i].revents = 0;
+				if ((events[i] & std::ios_base::in) != 0)
+					pfds[i].events |= POLLIN;
+				if ((events[i] & std::ios_base::out) != 0)
+					pfds[i].events |= POLLOUT;
+			}
+			result = ::poll(pfds, count, timeout);
+			if (result == -1 && errno == EINTR) result = 0;
+			for (int i = 0; i < count; ++i) {
+				ready[i] = std::ios_base::openmode();
+				if ((pfds[i].revents & (POLLHUP | POLLERR |
+								POLLNVAL)) != 0)
+					ready[i] = events[i];
+				if ((pfds[i].revents & POLLIN) != 0)
+					ready[i] |= std::ios_base::in;
+				if ((pfds[i].revents & POLLOUT) != 0)
+					ready[i] |= std::ios_base::out;
+			}
+			return result;
+		}
+
 		static int shutdown(socket_type socket, std::ios_base::
 							openmode how)
 		{
@@ -158,6 +1125,192 @@ namespace swoope {
 		{
 			return ::close(socket);
 		}
+
+		/*
+		 * Corks or uncorks the socket. While corked, the system holds
+		 * back partial segments, for at most 200 ms on Linux, and
+		 * uncorking sends them. Returns 0 on success.
+		 */
+		static int set_cork(socket_type socket, bool on)
+		{
+#if defined(TCP_CORK)
+			int optval((on != false) ? 1 : 0);
+
+			return ::setsockopt(socket, IPPROTO_TCP, TCP_CORK, &optval,
+							sizeof(optval));
+#else
+			(void)socket;
+			(void)on;
+			errno = ENOPROTOOPT;
+			return -1;
+#endif
+		}
+
+		/*
+		 * Enables or disables zero-copy sends on the socket. Returns 0 on
+		 * success.
+		 */
+		static int set_zerocopy(socket_type socket, bool on)
+		{
+#if defined(SO_ZEROCOPY)
+			int optval((on != false) ? 1 : 0);
+
+			return ::setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY,
+						&optval, sizeof(optval));
+#else
+			(void)socket;
+			(void)on;
+			errno = ENOPROTOOPT;
+			return -1;
+#endif
+		}
+
+		/*
+		 * Sends from buf without copying it into the kernel. buf must not
+		 * change until zerocopy_completion reports the send as done.
+		 */
+		static std::streamsize write_zerocopy(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+#if defined(MSG_ZEROCOPY)
+			return ::send(socket, buf, n, MSG_ZEROCOPY);
+#else
+			return ::send(socket, buf, n, 0);
+#endif
+		}
+
+		/*
+		 * Retrieves one zero-copy completion covering the zero-copy sends
+		 * numbered first through last, counting from 0 on each socket. If
+		 * wait is true, blocks until one arrives. Returns 1 if a completion
+		 * was retrieved, 0 if none is available and -1 on error.
+		 */
+		static int zerocopy_completion(socket_type socket,
+						unsigned& first,
+						unsigned& last,
+						bool wait)
+		{
+#if defined(MSG_ZEROCOPY)
+			char control[CMSG_SPACE(sizeof(sock_extended_err)) + 64];
+			const sock_extended_err* serr;
+			cmsghdr* cm;
+			msghdr msg = msghdr();
+			pollfd pfd = pollfd();
+			bool hangup(false);
+
+			for (;;) {
+				msg.msg_control = control;
+				msg.msg_controllen = sizeof(control);
+				if (::recvmsg(socket, &msg, MSG_ERRQUEUE) == -1) {
+					if (errno == EINTR) continue;
+					if (errno != EAGAIN && errno != EWOULDBLOCK)
+						return -1;
+					if (wait == false || hangup != false)
+						return 0;
+					/* A pending error queue is reported as POLLERR */
+					pfd.fd = socket;
+					pfd.events = 0;
+					if (::poll(&pfd, 1, -1) == -1 &&
+							errno != EINTR)
+						return -1;
+					if ((pfd.revents & POLLNVAL) != 0)
+						return -1;
+					hangup = (pfd.revents & POLLHUP) != 0;
+					continue;
+				}
+				for (cm = CMSG_FIRSTHDR(&msg); cm != 0;
+						cm = CMSG_NXTHDR(&msg, cm)) {
+					if ((cm->cmsg_level != SOL_IP ||
+						cm->cmsg_type != IP_RECVERR) &&
+						(cm->cmsg_level != SOL_IPV6 ||
+						cm->cmsg_type != IPV6_RECVERR))
+						continue;
+					serr = reinterpret_cast<const
+						sock_extended_err*>(CMSG_DATA(cm));
+					if (serr->ee_origin !=
+						SO_EE_ORIGIN_ZEROCOPY ||
+						serr->ee_errno != 0)
+						continue;
+					first = serr->ee_info;
+					last = serr->ee_data;
+					return 1;
+				}
+			}
+#else
+			(void)socket;
+			(void)first;
+			(void)last;
+			(void)wait;
+			errno = ENOPROTOOPT;
+			return -1;
+#endif
+		}
+
+		/* Sets a socket option. Returns 0 on success. */
+		static int set_option(socket_type socket,
+					const socket_option& option)
+		{
+			int level, name;
+
+			if (option_name(option.name, level, name) != 0) {
+				errno = ENOPROTOOPT;
+				return -1;
+			}
+			return ::setsockopt(socket, level, name, &option.value,
+						sizeof(option.value));
+		}
+
+		/*
+		 * Reads the value of the option named in option into its value.
+		 * Returns 0 on success.
+		 */
+		static int get_option(socket_type socket, socket_option& option)
+		{
+			int level, name;
+			socklen_t len(sizeof(option.value));
+
+			if (option_name(option.name, level, name) != 0) {
+				errno = ENOPROTOOPT;
+				return -1;
+			}
+			return ::getsockopt(socket, level, name, &option.value,
+									&len);
+		}
+
+		/*
+		 * Puts the socket into blocking or non-blocking mode. Returns 0 on
+		 * success.
+		 */
+		static int set_blocking(socket_type socket, bool blocking)
+		{
+			int flags(::fcntl(socket, F_GETFL, 0));
+
+			if (flags == -1) return -1;
+			if (blocking != false)
+				flags &= ~O_NONBLOCK;
+			else
+				flags |= O_NONBLOCK;
+			return ::fcntl(socket, F_SETFL, flags) == -1 ? -1 : 0;
+		}
+
+		/*
+		 * Returns true if the last failed operation on the calling thread
+		 * failed because a non-blocking socket was not ready.
+		 */
+		static bool would_block()
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+
+		/*
+		 * Returns true if the last failed operation on the calling thread
+		 * failed because its time limit passed.
+		 */
+		static bool timed_out()
+		{
+			return errno == ETIMEDOUT;
+		}
 	};
 
 }
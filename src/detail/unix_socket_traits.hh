@@ -0,0 +1,385 @@
+#ifndef SWOOPE_UNIX_SOCKET_TRAITS_HH
+#define SWOOPE_UNIX_SOCKET_TRAITS_HH
+
+/*
+ * unix_socket_traits.hh
+ */
+
+#include "posix_native_socket_traits.hh"
+
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace swoope {
+
+	/*
+	 * Socket traits for local (AF_UNIX) sockets of type Type, SOCK_STREAM
+	 * or SOCK_SEQPACKET. Where the TCP traits take a host and a service,
+	 * these take a path: open(path, "") or open("", path) connects, and
+	 * open(path, backlog) listens, replacing a stale socket file. A path
+	 * that starts with '@' names a socket in the abstract namespace
+	 * (Linux). File descriptors can be sent along with data and are
+	 * collected as the data carrying them is read.
+	 *
+	 * With SOCK_SEQPACKET every send is one message, so each flush of the
+	 * put area is one message, and the get area must be large enough for
+	 * the largest message, since the rest of a message is discarded.
+	 */
+	template <int Type>
+	struct basic_unix_socket_traits : native_socket_traits {
+
+		/* Most file descriptors sent with one write */
+		enum { max_descriptors = 64 };
+
+		static socket_type open(const std::string& host,
+					const std::string& service)
+		{
+			return open(host, service, connect_options());
+		}
+
+		/*
+		 * Only the socket options of options apply, since connecting to
+		 * a local socket neither resolves names nor waits for a peer.
+		 */
+		static socket_type open(const std::string& host,
+					const std::string& service,
+					const connect_options& options)
+		{
+			sockaddr_un address;
+			socklen_t length;
+			socket_type result;
+
+			if (make_address(host.empty() != false ? service : host,
+						address, length) != 0)
+				return invalid();
+			result = make_socket(options.socket_options);
+			if (result == invalid()) return result;
+			if (::connect(result, (sockaddr*)&address, length) != 0)
+				return fail(result);
+			return result;
+		}
+
+		static socket_type open(const std::string& service,
+							int backlog)
+		{
+			return open(service, backlog, listener_options());
+		}
+
+		/* CPU steering and SO_REUSEPORT do not apply to local sockets. */
+		static socket_type open(const std::string& service,
+					int backlog,
+					const listener_options& options)
+		{
+			sockaddr_un address;
+			socklen_t length;
+			socket_type result;
+			struct stat st;
+
+			if (options.reuse_port != false ||
+					options.incoming_cpu != -1 ||
+					options.steer_by_cpu != false) {
+				errno = EOPNOTSUPP;
+				return invalid();
+			}
+			if (make_address(service, address, length) != 0)
+				return invalid();
+			result = make_socket(options.socket_options);
+			if (result == invalid()) return result;
+			/*
+			 * A socket file left behind by an earlier listener is
+			 * replaced, but not one that a listener still serves.
+			 */
+			if (address.sun_path[0] != '\0' &&
+					::lstat(address.sun_path, &st) == 0 &&
+					S_ISSOCK(st.st_mode)) {
+				if (stale(address, length) == false) {
+					::close(result);
+					errno = EADDRINUSE;
+					return invalid();
+				}
+				::unlink(address.sun_path);
+			}
+			if (::bind(result, (sockaddr*)&address, length) != 0 ||
+					::listen(result, backlog) != 0)
+				return fail(result);
+			return result;
+		}
+
+		static std::streamsize read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			iovec iov;
+
+			iov.iov_base = buf;
+			iov.iov_len = static_cast<std::size_t>(n);
+			return receive(socket, &iov, 1, 0);
+		}
+
+		static std::streamsize read(socket_type socket,
+						void* buf1,
+						std::streamsize n1,
+						void* buf2,
+						std::streamsize n2)
+		{
+			iovec iov[2];
+
+			iov[0].iov_base = buf1;
+			iov[0].iov_len = static_cast<std::size_t>(n1);
+			iov[1].iov_base = buf2;
+			iov[1].iov_len = static_cast<std::size_t>(n2);
+			return receive(socket, iov, 2, 0);
+		}
+
+		static std::streamsize try_read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			iovec iov;
+
+			iov.iov_base = buf;
+			iov.iov_len = static_cast<std::size_t>(n);
+			return receive(socket, &iov, 1, MSG_DONTWAIT);
+		}
+
+		static std::streamsize read_all(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			std::streamsize got(0), result(0);
+			iovec iov;
+
+			while (result < n) {
+				iov.iov_base = static_cast<char*>(buf) + result;
+				iov.iov_len = static_cast<std::size_t>(n - result);
+				got = receive(socket, &iov, 1, MSG_WAITALL);
+				if (got < 0 && errno == EINTR) continue;
+				if (got <= 0) break;
+				result += got;
+			}
+			return (result == 0 && got < 0) ? -1 : result;
+		}
+
+		/*
+		 * Sends n bytes of buf, at least one, with count file
+		 * descriptors attached. Returns the number of bytes sent, which
+		 * may be short, or -1 on error. The descriptors go with the
+		 * first byte, so a short write has sent them.
+		 */
+		static std::streamsize write_descriptors(socket_type socket,
+						const void* buf,
+						std::streamsize n,
+						const int* fds,
+						std::size_t count)
+		{
+			msghdr msg = msghdr();
+			iovec iov;
+			control_type control;
+			cmsghdr* cm;
+
+			if (n < 1 || count > max_descriptors) {
+				errno = EINVAL;
+				return -1;
+			}
+			iov.iov_base = const_cast<void*>(buf);
+			iov.iov_len = static_cast<std::size_t>(n);
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			if (count != 0) {
+				std::memset(&control, 0, sizeof(control));
+				msg.msg_control = control.buf;
+				msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+				cm = CMSG_FIRSTHDR(&msg);
+				cm->cmsg_level = SOL_SOCKET;
+				cm->cmsg_type = SCM_RIGHTS;
+				cm->cmsg_len = CMSG_LEN(sizeof(int) * count);
+				std::memcpy(CMSG_DATA(cm), fds, sizeof(int) * count);
+			}
+			return ::sendmsg(socket, &msg, 0);
+		}
+
+		/*
+		 * Moves up to max of the file descriptors received on socket so
+		 * far into fds, oldest first, and returns how many were moved.
+		 */
+		static std::size_t take_descriptors(socket_type socket,
+						int* fds, std::size_t max)
+		{
+			descriptor_table& t(table());
+			typename descriptor_map::iterator i;
+			std::size_t result(0);
+
+			::pthread_mutex_lock(&t.lock);
+			i = t.received.find(socket);
+			if (i != t.received.end()) {
+				while (result < max && i->second.empty() == false) {
+					fds[result++] = i->second.front();
+					i->second.pop_front();
+				}
+				if (i->second.empty() != false) t.received.erase(i);
+			}
+			::pthread_mutex_unlock(&t.lock);
+			return result;
+		}
+
+		/* Closes the socket and any descriptors nobody took from it. */
+		static int close(socket_type socket)
+		{
+			descriptor_table& t(table());
+			typename descriptor_map::iterator i;
+
+			::pthread_mutex_lock(&t.lock);
+			i = t.received.find(socket);
+			if (i != t.received.end()) {
+				for (std::size_t j = 0; j < i->second.size(); ++j)
+					::close(i->second[j]);
+				t.received.erase(i);
+			}
+			::pthread_mutex_unlock(&t.lock);
+			return ::close(socket);
+		}
+	private:
+		typedef std::map<socket_type, std::deque<int> > descriptor_map;
+
+		struct descriptor_table {
+			pthread_mutex_t lock;
+			descriptor_map received;
+		};
+
+		union control_type {
+			cmsghdr align;
+			char buf[CMSG_SPACE(sizeof(int) * max_descriptors)];
+		};
+
+		/* Descriptors received but not yet taken, per socket */
+		static descriptor_table& table()
+		{
+			static descriptor_table result = {
+				PTHREAD_MUTEX_INITIALIZER, descriptor_map()
+			};
+
+			return result;
+		}
+
+		static int make_address(const std::string& path,
+					sockaddr_un& address, socklen_t& length)
+		{
+			std::memset(&address, 0, sizeof(address));
+			if (path.empty() != false ||
+					path.size() >= sizeof(address.sun_path)) {
+				errno = path.empty() != false ? EINVAL :
+								ENAMETOOLONG;
+				return -1;
+			}
+			address.sun_family = AF_UNIX;
+			std::memcpy(address.sun_path, path.data(), path.size());
+			length = static_cast<socklen_t>(
+					offsetof(sockaddr_un, sun_path) + path.size());
+			/* Abstract names are not null-terminated */
+			if (path[0] == '@')
+				address.sun_path[0] = '\0';
+			else
+				++length;
+			return 0;
+		}
+
+		static socket_type make_socket(
+				const std::vector<socket_option>& options)
+		{
+			socket_type result((::socket(AF_UNIX, Type, 0)));
+
+			if (result == invalid()) return result;
+			if (::fcntl(result, F_SETFD, FD_CLOEXEC) == -1)
+				return fail(result);
+			for (std::size_t i = 0; i < options.size(); ++i)
+				if (set_option(result, options[i]) != 0)
+					return fail(result);
+			return result;
+		}
+
+		/* Returns true if nothing listens on the socket file address. */
+		static bool stale(const sockaddr_un& address, socklen_t length)
+		{
+			socket_type probe((::socket(AF_UNIX, Type, 0)));
+			bool result;
+
+			if (probe == invalid()) return false;
+			result = ::connect(probe, (const sockaddr*)&address,
+						length) != 0 && errno == ECONNREFUSED;
+			::close(probe);
+			return result;
+		}
+
+		/* Closes socket, keeping errno, and returns invalid(). */
+		static socket_type fail(socket_type socket)
+		{
+			int error(errno);
+
+			::close(socket);
+			errno = error;
+			return invalid();
+		}
+
+		/*
+		 * Receives into iov and files away the descriptors that came
+		 * with the data.
+		 */
+		static std::streamsize receive(socket_type socket, iovec* iov,
+							int count, int flags)
+		{
+			msghdr msg = msghdr();
+			control_type control;
+			std::streamsize result;
+
+			msg.msg_iov = iov;
+			msg.msg_iovlen = count;
+			msg.msg_control = control.buf;
+			msg.msg_controllen = sizeof(control.buf);
+#if defined(MSG_CMSG_CLOEXEC)
+			flags |= MSG_CMSG_CLOEXEC;
+#endif
+			result = ::recvmsg(socket, &msg, flags);
+			if (result >= 0 && msg.msg_controllen != 0)
+				keep(socket, msg);
+			return result;
+		}
+
+		static void keep(socket_type socket, msghdr& msg)
+		{
+			descriptor_table& t(table());
+			cmsghdr* cm;
+			std::size_t n;
+			int fd;
+
+			::pthread_mutex_lock(&t.lock);
+			for (cm = CMSG_FIRSTHDR(&msg); cm != 0;
+					cm = CMSG_NXTHDR(&msg, cm)) {
+				if (cm->cmsg_level != SOL_SOCKET ||
+						cm->cmsg_type != SCM_RIGHTS)
+					continue;
+				n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				for (std::size_t i = 0; i < n; ++i) {
+					std::memcpy(&fd, CMSG_DATA(cm) +
+						i * sizeof(int), sizeof(int));
+#if !defined(MSG_CMSG_CLOEXEC)
+					::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+					t.received[socket].push_back(fd);
+				}
+			}
+			::pthread_mutex_unlock(&t.lock);
+		}
+	};
+
+	typedef basic_unix_socket_traits<SOCK_STREAM> unix_socket_traits;
+	typedef basic_unix_socket_traits<SOCK_SEQPACKET>
+					unix_seqpacket_socket_traits;
+
+}
+
+#endif
@@ -18,15 +18,29 @@
 
 #include <Winsock2.h>
 #include <Ws2tcpip.h>
+#include <io.h>
+#include <stdio.h>
+#include <sys/types.h>
 
+#include <algorithm>
+#include <cstring>
 #include <ios>
 #include <string>
+#include <vector>
+#include "../connect_options.hh"
+#include "../datagram.hh"
+#include "../endpoint.hh"
+#if __cplusplus >= 201103L
+#include "../resolver_cache.hh"
+#endif
+#include "../listener_options.hh"
 
 namespace swoope {
 
 	struct native_socket_traits {
 
 		typedef SOCKET socket_type;
+		typedef SOCKADDR_STORAGE address_type;
 
 		static socket_type invalid()
 		{
@@ -36,34 +50,66 @@ namespace swoope {
 		static socket_type open(const std::string& host,
 					const std::string& service)
 		{
-			using std::swap;
+			return open(host, service, connect_options());
+		}
+
+		/*
+		 * Connects to the addresses of host one after another until one
+		 * succeeds, within options.timeout in all. Winsock before Vista
+		 * has no poll, so attempts are not raced and options.attempt_delay
+		 * is not used.
+		 */
+		static socket_type open(const std::string& host,
+					const std::string& service,
+					const connect_options& options)
+		{
 			addrinfo *ai, hints = addrinfo();
-			socket_type result((invalid()));
+			socket_type result;
+
+#if __cplusplus >= 201103L
+			if (options.resolver != 0) {
+				resolver_cache::result_type r((options.resolver->
+						resolve(host, service)));
 
+				if (!r) return invalid();
+				return connect_any(r.get(), options);
+			}
+#endif
 			hints.ai_family = AF_UNSPEC;
 			hints.ai_socktype = SOCK_STREAM;
 			hints.ai_protocol = IPPROTO_TCP;
 			if (::getaddrinfo(host.c_str(), service.c_str(),
 							&hints, &ai) != 0)
-				return result;
-			socket_type socket((::socket(ai->ai_family,
-							ai->ai_socktype,
-							ai->ai_protocol)));
-			if (socket != result && ::connect(socket, ai->ai_addr,
-					static_cast<int>(ai->ai_addrlen)) == 0)
-				swap(result, socket);
+				return invalid();
+			result = connect_any(ai, options);
 			::freeaddrinfo(ai);
 			return result;
 		}
 
 		static socket_type open(const std::string& service, 
 							int backlog)
+		{
+			return open(service, backlog, listener_options());
+		}
+
+		/*
+		 * Winsock has no SO_REUSEPORT or CPU steering, so only
+		 * options.socket_options can be honoured.
+		 */
+		static socket_type open(const std::string& service,
+					int backlog,
+					const listener_options& options)
 		{
 			using std::swap;
 			addrinfo *ai, hints = addrinfo();
 			socket_type result((invalid()));
 			BOOL optval = TRUE;
 
+			if (options.reuse_port != false ||
+					options.incoming_cpu != -1 ||
+					options.steer_by_cpu != false)
+				return result;
+
 			hints.ai_family = AF_UNSPEC;
 			hints.ai_socktype = SOCK_STREAM;
 			hints.ai_protocol = IPPROTO_TCP;
@@ -73,9 +119,14 @@ namespace swoope {
 			socket_type socket((::socket(ai->ai_family,
 							ai->ai_socktype,
 							ai->ai_protocol)));
-			if (socket == result) return result;
+			if (socket == result) {
+				::freeaddrinfo(ai);
+				return result;
+			}
 			if (::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR,
 				(const char*)&optval, sizeof(optval)) != 0 ||
+				set_options(socket,
+					options.socket_options) != 0 ||
 				::bind(socket, ai->ai_addr,
 				ai->ai_addrlen) != 0 ||
 				::listen(socket, backlog) != 0) {
@@ -91,9 +142,140 @@ namespace swoope {
 		{
 			return ::accept(sock, 0, 0);
 		}
+
+		/*
+		 * Accepts a connection and stores the peer's address in peer. The
+		 * new socket is switched to non-blocking mode if nonblocking is
+		 * true and to blocking mode otherwise.
+		 */
+		static socket_type accept(socket_type sock, address_type& peer,
+							bool nonblocking)
+		{
+			int len(sizeof(peer));
+			socket_type result((::accept(sock, (SOCKADDR*)&peer,
+								&len)));
+
+			if (result == invalid()) return result;
+			if (set_blocking(result, !nonblocking) != 0) {
+				close(result);
+				result = invalid();
+			}
+			return result;
+		}
 	private:
+		static int set_options(socket_type socket,
+				const std::vector<socket_option>& options)
+		{
+			for (std::size_t i = 0; i < options.size(); ++i)
+				if (set_option(socket, options[i]) != 0)
+					return -1;
+			return 0;
+		}
+
+		/* Finds the level and option of name. Returns -1 if unknown. */
+		static int option_name(socket_option::name_type name,
+						int& level, int& option)
+		{
+			switch (name) {
+			case socket_option::nodelay:
+				level = IPPROTO_TCP;
+				option = TCP_NODELAY;
+				return 0;
+			case socket_option::send_buffer:
+				level = SOL_SOCKET;
+				option = SO_SNDBUF;
+				return 0;
+			case socket_option::receive_buffer:
+				level = SOL_SOCKET;
+				option = SO_RCVBUF;
+				return 0;
+			case socket_option::keepalive:
+				level = SOL_SOCKET;
+				option = SO_KEEPALIVE;
+				return 0;
+			default:
+				return -1;
+			}
+		}
+
+		/* Connects to the first address of ai that accepts */
+		static socket_type connect_any(const addrinfo* ai,
+					const connect_options& options)
+		{
+			const addrinfo* i;
+			socket_type result((invalid()));
+			long deadline(-1), left(-1);
+			int error;
+
+			if (options.timeout >= 0)
+				deadline = monotonic_time() + options.timeout;
+			for (i = ai; i != 0 && result == invalid();
+							i = i->ai_next) {
+				if (deadline != -1 &&
+					(left = deadline - monotonic_time()) <= 0) {
+					::WSASetLastError(WSAETIMEDOUT);
+					break;
+				}
+				result = ::socket(i->ai_family, i->ai_socktype,
+							i->ai_protocol);
+				if (result != invalid() && (set_options(result,
+					options.socket_options) != 0 ||
+					connect_within(result, i, left) != 0)) {
+					error = ::WSAGetLastError();
+					::closesocket(result);
+					::WSASetLastError(error);
+					result = invalid();
+				}
+			}
+			return result;
+		}
+
+		/*
+		 * Connects socket to the address of ai, waiting at most timeout
+		 * milliseconds (-1 for no limit). Returns 0 on success.
+		 */
+		static int connect_within(socket_type socket, const addrinfo* ai,
+								long timeout)
+		{
+			fd_set wfds, efds;
+			timeval tv;
+			int error(0), len(sizeof(error));
+
+			if (timeout < 0)
+				return ::connect(socket, ai->ai_addr,
+					static_cast<int>(ai->ai_addrlen)) == 0 ?
+									0 : -1;
+			if (set_blocking(socket, false) != 0) return -1;
+			if (::connect(socket, ai->ai_addr,
+					static_cast<int>(ai->ai_addrlen)) != 0) {
+				if (::WSAGetLastError() != WSAEWOULDBLOCK)
+					return -1;
+				FD_ZERO(&wfds);
+				FD_ZERO(&efds);
+				FD_SET(socket, &wfds);
+				FD_SET(socket, &efds);
+				tv.tv_sec = timeout / 1000;
+				tv.tv_usec = (timeout % 1000) * 1000;
+				switch (::select(0, 0, &wfds, &efds, &tv)) {
+				case SOCKET_ERROR:
+					return -1;
+				case 0:
+					::WSASetLastError(WSAETIMEDOUT);
+					return -1;
+				}
+				/* A failed connect is reported as an exception */
+				if (FD_ISSET(socket, &efds)) {
+					::getsockopt(socket, SOL_SOCKET, SO_ERROR,
+							(char*)&error, &len);
+					::WSASetLastError(error);
+					return -1;
+				}
+			}
+			return set_blocking(socket, true);
+		}
+
 		static std::string sockaddr_storage_to_string(
-					SOCKADDR_STORAGE *ss)
+					const SOCKADDR_STORAGE *ss)
 		{
 			std::string result;
 			socklen_t sslen(sizeof(*ss));
@@ -110,6 +292,14 @@ namespace swoope {
 			}
 			return result;
 		}
+
+		static LONGLONG performance_count()
+		{
+			LARGE_INTEGER count;
+
+			::QueryPerformanceCounter(&count);
+			return count.QuadPart;
+		}
 	public:
 		static std::string local_address(socket_type sock)
 		{
@@ -131,6 +321,49 @@ namespace swoope {
 			return sockaddr_storage_to_string(&ss);
 		}
 
+		/* Converts an address returned by accept to an endpoint */
+		static endpoint to_endpoint(const address_type& address)
+		{
+			const sockaddr_in* in4;
+			const sockaddr_in6* in6;
+
+			switch (address.ss_family) {
+			case AF_INET:
+				in4 = (const sockaddr_in*)&address;
+				return endpoint(endpoint::ipv4,
+					(const unsigned char*)&in4->sin_addr,
+					ntohs(in4->sin_port));
+			case AF_INET6:
+				in6 = (const sockaddr_in6*)&address;
+				return endpoint(endpoint::ipv6,
+					(const unsigned char*)&in6->sin6_addr,
+					ntohs(in6->sin6_port),
+					in6->sin6_scope_id);
+			default:
+				return endpoint();
+			}
+		}
+
+		static endpoint local_endpoint(socket_type sock)
+		{
+			address_type ss;
+			int sl = sizeof(ss);
+
+			if (::getsockname(sock, (SOCKADDR*)&ss, &sl) != 0)
+				return endpoint();
+			return to_endpoint(ss);
+		}
+
+		static endpoint remote_endpoint(socket_type sock)
+		{
+			address_type ss;
+			int sl = sizeof(ss);
+
+			if (::getpeername(sock, (SOCKADDR*)&ss, &sl) != 0)
+				return endpoint();
+			return to_endpoint(ss);
+		}
+
 		static std::streamsize read(socket_type socket,
 						void* buf,
 						std::streamsize n)
@@ -139,6 +372,85 @@ namespace swoope {
 					static_cast<int>(n), 0);
 		}
 
+		/*
+		 * Receive exactly n bytes unless the peer shuts down or an error
+		 * occurs. Returns the number of bytes received, or -1 if an
+		 * error occurred before anything was received.
+		 */
+		static std::streamsize read_all(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			std::streamsize got(0), result(0);
+
+			/* Before Windows Server 2003 the loop does the waiting */
+			while (result < n) {
+				got = ::recv(socket, static_cast<char*>(buf) +
+						result, static_cast<int>(n - result),
+#if defined(MSG_WAITALL)
+						MSG_WAITALL);
+#else
+						0);
+#endif
+				if (got <= 0) break;
+				result += got;
+			}
+			return (result == 0 && got < 0) ? -1 : result;
+		}
+
+		/*
+		 * Waits until input is available without consuming it. Returns 1
+		 * if there is input, 0 if the peer has shut down, or -1 on error.
+		 */
+		static int peek(socket_type socket)
+		{
+			char c;
+
+			return ::recv(socket, &c, 1, MSG_PEEK);
+		}
+
+		/*
+		 * Reads what is already queued, without waiting even if the
+		 * socket is blocking. Returns -1 with would_block() set if
+		 * nothing is.
+		 */
+		static std::streamsize try_read(socket_type socket,
+						void* buf,
+						std::streamsize n)
+		{
+			u_long queued(0);
+
+			if (::ioctlsocket(socket, FIONREAD, &queued) != 0)
+				return -1;
+			if (queued == 0) {
+				::WSASetLastError(WSAEWOULDBLOCK);
+				return -1;
+			}
+			return read(socket, buf, n);
+		}
+
+		/*
+		 * Scatter-read into buf1 and then buf2 with a single system call.
+		 * Returns the total number of bytes received.
+		 */
+		static std::streamsize read(socket_type socket,
+						void* buf1,
+						std::streamsize n1,
+						void* buf2,
+						std::streamsize n2)
+		{
+			WSABUF wb[2];
+			DWORD got(0), flags(0);
+
+			wb[0].buf = static_cast<char*>(buf1);
+			wb[0].len = static_cast<ULONG>(n1);
+			wb[1].buf = static_cast<char*>(buf2);
+			wb[1].len = static_cast<ULONG>(n2);
+			if (::WSARecv(socket, wb, 2, &got, &flags, 0, 0) != 0)
+				return -1;
+			return static_cast<std::streamsize>(got);
+		}
+
 		static std::streamsize write(socket_type socket,
 						const void* buf,
 						std::streamsize n)
@@ -147,6 +459,300 @@ namespace swoope {
 						static_cast<int>(n), 0);
 		}
 
+		/*
+		 * Gather-write buf1 followed by buf2 with a single system call.
+		 * Returns the total number of bytes sent, which may be short.
+		 */
+		static std::streamsize write(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			WSABUF wb[2];
+			DWORD sent(0);
+
+			wb[0].buf = const_cast<char*>(
+					static_cast<const char*>(buf1));
+			wb[0].len = static_cast<ULONG>(n1);
+			wb[1].buf = const_cast<char*>(
+					static_cast<const char*>(buf2));
+			wb[1].len = static_cast<ULONG>(n2);
+			if (::WSASend(socket, wb, 2, &sent, 0, 0, 0) != 0)
+				return -1;
+			return static_cast<std::streamsize>(sent);
+		}
+
+		/* Winsock has no MSG_MORE, so these are plain writes. */
+		static std::streamsize write_more(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			return write(socket, buf, n);
+		}
+
+		static std::streamsize write_more(socket_type socket,
+						const void* buf1,
+						std::streamsize n1,
+						const void* buf2,
+						std::streamsize n2)
+		{
+			return write(socket, buf1, n1, buf2, n2);
+		}
+
+		/*
+		 * Returns a monotonic time in milliseconds, counted from the
+		 * first call so that a 32-bit long lasts for weeks.
+		 */
+		static long monotonic_time()
+		{
+			static const LONGLONG origin(performance_count());
+			LARGE_INTEGER frequency;
+			LONGLONG count(performance_count() - origin);
+
+			::QueryPerformanceFrequency(&frequency);
+			return static_cast<long>(count / frequency.QuadPart * 1000 +
+				count % frequency.QuadPart * 1000 /
+							frequency.QuadPart);
+		}
+
+		/*
+		 * Sends up to length bytes of file descriptor fd starting at offset.
+		 * Winsock has no descriptor-based sendfile, so the bytes are read
+		 * through a local buffer. Returns the number of bytes sent, 0 at
+		 * end of file, or -1 on error.
+		 */
+		static std::streamsize send_file(socket_type socket, int fd,
+						off_t offset,
+						std::size_t length)
+		{
+			char buf[4096];
+			int got;
+
+			if (::_lseeki64(fd, offset, SEEK_SET) == -1) return -1;
+			got = ::_read(fd, buf, static_cast<unsigned>(
+					length < sizeof(buf) ? length :
+							sizeof(buf)));
+			if (got <= 0) return got;
+			return write(socket, buf, got);
+		}
+
+		/*
+		 * Winsock cannot splice, so no pipe is needed and data is moved
+		 * through a local buffer instead.
+		 */
+		static int open_pipe(int pipe[2])
+		{
+			pipe[0] = pipe[1] = -1;
+			return 0;
+		}
+
+		static void close_pipe(int pipe[2])
+		{
+			pipe[0] = pipe[1] = -1;
+		}
+
+		/*
+		 * Moves up to n bytes received on from to socket to. Nothing is
+		 * ever left staged, so bytes received but not sent when a send
+		 * fails are lost. Returns the number of bytes moved, 0 at end of
+		 * stream, or -1 on error.
+		 */
+		static std::streamsize splice(socket_type from, socket_type to,
+						int*, std::streamsize n,
+						std::streamsize&)
+		{
+			char buf[4096];
+			int got, put(0), moved;
+
+			got = ::recv(from, buf, static_cast<int>(n < static_cast<
+				std::streamsize>(sizeof(buf)) ? n :
+						sizeof(buf)), 0);
+			if (got <= 0) return got;
+			for (moved = 0; moved < got; moved += put) {
+				put = ::send(to, buf + moved, got - moved, 0);
+				if (put <= 0) return -1;
+			}
+			return got;
+		}
+
+		/* Most datagrams send_datagrams and receive_datagrams handle per call */
+		enum { datagram_batch = 64 };
+
+		/*
+		 * Opens a UDP socket. With a host, the socket is connected to the
+		 * first address of host and service. Otherwise it is bound to
+		 * service on the first local address getaddrinfo offers.
+		 */
+		static socket_type open_datagram(const std::string& host,
+						const std::string& service)
+		{
+			addrinfo *ai, hints = addrinfo();
+			socket_type result;
+			int error;
+
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_DGRAM;
+			hints.ai_protocol = IPPROTO_UDP;
+			if (host.empty() != false) hints.ai_flags |= AI_PASSIVE;
+			if (::getaddrinfo(host.empty() != false ? 0 : host.c_str(),
+					service.c_str(), &hints, &ai) != 0)
+				return invalid();
+			result = ::socket(ai->ai_family, ai->ai_socktype,
+							ai->ai_protocol);
+			if (result != invalid() && (host.empty() != false ?
+				::bind(result, ai->ai_addr,
+					static_cast<int>(ai->ai_addrlen)) :
+				::connect(result, ai->ai_addr,
+					static_cast<int>(ai->ai_addrlen))) != 0) {
+				error = ::WSAGetLastError();
+				close(result);
+				::WSASetLastError(error);
+				result = invalid();
+			}
+			::freeaddrinfo(ai);
+			return result;
+		}
+
+		/*
+		 * Converts e to a socket address. Returns the length of the
+		 * address, or 0 if e is empty.
+		 */
+		static int to_address(const endpoint& e, address_type& address)
+		{
+			sockaddr_in* in4;
+			sockaddr_in6* in6;
+
+			std::memset(&address, 0, sizeof(address));
+			switch (e.family()) {
+			case endpoint::ipv4:
+				in4 = (sockaddr_in*)&address;
+				in4->sin_family = AF_INET;
+				in4->sin_port = htons(e.port());
+				std::memcpy(&in4->sin_addr, e.address(), 4);
+				return sizeof(*in4);
+			case endpoint::ipv6:
+				in6 = (sockaddr_in6*)&address;
+				in6->sin6_family = AF_INET6;
+				in6->sin6_port = htons(e.port());
+				in6->sin6_scope_id = static_cast<ULONG>(
+								e.scope_id());
+				std::memcpy(&in6->sin6_addr, e.address(), 16);
+				return sizeof(*in6);
+			default:
+				return 0;
+			}
+		}
+
+		/*
+		 * Sends up to datagram_batch of the count datagrams one by one,
+		 * since Winsock has no sendmmsg. Segmentation offload is not
+		 * supported. Returns how many were sent, or -1 if none was.
+		 */
+		static int send_datagrams(socket_type socket, const datagram* d,
+							std::size_t count)
+		{
+			address_type address;
+			int result, n(static_cast<int>(std::min(count,
+				static_cast<std::size_t>(datagram_batch)))), len;
+
+			for (result = 0; result < n; ++result) {
+				if (d[result].segment_size != 0) {
+					::WSASetLastError(WSAEOPNOTSUPP);
+					break;
+				}
+				len = to_address(d[result].peer, address);
+				if (::sendto(socket, d[result].data,
+					static_cast<int>(d[result].size), 0,
+					len != 0 ? (sockaddr*)&address : 0,
+					len) == SOCKET_ERROR)
+					break;
+			}
+			return (result == 0) ? -1 : result;
+		}
+
+		/*
+		 * Receives one datagram, since Winsock can neither batch receives
+		 * nor make a single call non-blocking. wait is ignored. Returns 1,
+		 * or -1 on error.
+		 */
+		static int receive_datagrams(socket_type socket, datagram* d,
+						std::size_t count, bool wait)
+		{
+			address_type address;
+			int len(sizeof(address)), got;
+
+			(void)wait;
+			if (count == 0) return 0;
+			got = ::recvfrom(socket, d->data,
+					static_cast<int>(d->capacity), 0,
+					(sockaddr*)&address, &len);
+			d->truncated = false;
+			if (got == SOCKET_ERROR) {
+				/* The buffer holds the start of a longer message */
+				if (::WSAGetLastError() != WSAEMSGSIZE) return -1;
+				got = static_cast<int>(d->capacity);
+				d->truncated = true;
+			}
+			d->size = static_cast<std::size_t>(got);
+			d->peer = to_endpoint(address);
+			d->segment_size = 0;
+			return 1;
+		}
+
+		/* Winsock has no UDP GRO. */
+		static int set_gro(socket_type socket, bool on)
+		{
+			(void)socket;
+			(void)on;
+			::WSASetLastError(WSAENOPROTOOPT);
+			return -1;
+		}
+
+		/*
+		 * Waits up to timeout milliseconds (-1 for no limit) until one of
+		 * count sockets is ready for the input and/or output given in
+		 * events, and stores what each one is ready for in ready. Returns
+		 * the number of ready sockets, 0 on timeout, or -1 on error.
+		 */
+		static int poll(const socket_type* sockets,
+					const std::ios_base::openmode* events,
+					std::ios_base::openmode* ready,
+					int count, int timeout)
+		{
+			fd_set rfds, wfds, efds;
+			timeval tv, *tvp((timeout < 0) ? 0 : &tv);
+			int result(0);
+
+			FD_ZERO(&rfds);
+			FD_ZERO(&wfds);
+			FD_ZERO(&efds);
+			for (int i = 0; i < count; ++i) {
+				if ((events[i] & std::ios_base::in) != 0)
+					FD_SET(sockets[i], &rfds);
+				if ((events[i] & std::ios_base::out) != 0)
+					FD_SET(sockets[i], &wfds);
+				FD_SET(sockets[i], &efds);
+			}
+			tv.tv_sec = timeout / 1000;
+			tv.tv_usec = (timeout % 1000) * 1000;
+			if (::select(0, &rfds, &wfds, &efds, tvp) ==
+							SOCKET_ERROR)
+				return -1;
+			for (int i = 0; i < count; ++i) {
+				ready[i] = std::ios_base::openmode();
+				if (FD_ISSET(sockets[i], &efds))
+					ready[i] = events[i];
+				if (FD_ISSET(sockets[i], &rfds))
+					ready[i] |= std::ios_base::in;
+				if (FD_ISSET(sockets[i], &wfds))
+					ready[i] |= std::ios_base::out;
+				if (ready[i] != std::ios_base::openmode())
+					++result;
+			}
+			return result;
+		}
+
 		static int shutdown(socket_type socket, std::ios_base::
 							openmode how)
 		{
@@ -169,6 +775,95 @@ namespace swoope {
 			return (::closesocket(socket) == 0) ? 0 : -1;
 		}
 
+		/* Winsock has no TCP_CORK. */
+		static int set_cork(socket_type, bool)
+		{
+			::WSASetLastError(WSAENOPROTOOPT);
+			return -1;
+		}
+
+		/* Zero-copy sends are not available with Winsock. */
+		static int set_zerocopy(socket_type, bool)
+		{
+			return -1;
+		}
+
+		static std::streamsize write_zerocopy(socket_type socket,
+						const void* buf,
+						std::streamsize n)
+		{
+			return write(socket, buf, n);
+		}
+
+		static int zerocopy_completion(socket_type, unsigned&,
+							unsigned&, bool)
+		{
+			return -1;
+		}
+
+		/*
+		 * Sets a socket option. Options Winsock lacks fail with
+		 * WSAENOPROTOOPT. Returns 0 on success.
+		 */
+		static int set_option(socket_type socket,
+					const socket_option& option)
+		{
+			int level, name;
+
+			if (option_name(option.name, level, name) != 0) {
+				::WSASetLastError(WSAENOPROTOOPT);
+				return -1;
+			}
+			return ::setsockopt(socket, level, name,
+					(const char*)&option.value,
+					sizeof(option.value)) == 0 ? 0 : -1;
+		}
+
+		/*
+		 * Reads the value of the option named in option into its value.
+		 * Returns 0 on success.
+		 */
+		static int get_option(socket_type socket, socket_option& option)
+		{
+			int level, name, len(sizeof(option.value));
+
+			if (option_name(option.name, level, name) != 0) {
+				::WSASetLastError(WSAENOPROTOOPT);
+				return -1;
+			}
+			return ::getsockopt(socket, level, name,
+					(char*)&option.value, &len) == 0 ? 0 : -1;
+		}
+
+		/*
+		 * Puts the socket into blocking or non-blocking mode. Returns 0 on
+		 * success.
+		 */
+		static int set_blocking(socket_type socket, bool blocking)
+		{
+			u_long nonblocking((blocking != false) ? 0 : 1);
+
+			return ::ioctlsocket(socket, FIONBIO,
+					&nonblocking) == 0 ? 0 : -1;
+		}
+
+		/*
+		 * Returns true if the last failed operation on the calling thread
+		 * failed because a non-blocking socket was not ready.
+		 */
+		static bool would_block()
+		{
+			return ::WSAGetLastError() == WSAEWOULDBLOCK;
+		}
+
+		/*
+		 * Returns true if the last failed operation on the calling thread
+		 * failed because its time limit passed.
+		 */
+		static bool timed_out()
+		{
+			return ::WSAGetLastError() == WSAETIMEDOUT;
+		}
 	};
 
 }
@@ -0,0 +1,251 @@
+#ifndef SWOOPE_ENDPOINT_HH
+#define SWOOPE_ENDPOINT_HH
+
+/*
+ * endpoint.hh
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#if __cplusplus >= 201103L
+#include <functional>
+#endif
+
+namespace swoope {
+
+	/*
+	 * Binary IP address and port of one end of a connection. Comparing,
+	 * hashing and formatting an endpoint need no system calls and no
+	 * allocation.
+	 */
+	class endpoint {
+	public:
+		enum family_type {
+			unspecified = 0,
+			ipv4 = 4,
+			ipv6 = 6
+		};
+
+		/*
+		 * Buffer size that format() never needs more than: "[", 39
+		 * address characters, "%", 20 digits of a 64-bit scope id, "]:",
+		 * 5 port digits and the null character
+		 */
+		enum { max_string = 69 };
+
+		endpoint() :
+		fam(unspecified),
+		prt(0),
+		scope(0)
+		{
+			std::memset(addr, 0, sizeof(addr));
+		}
+
+		/*
+		 * address holds 4 bytes for ipv4 or 16 bytes for ipv6 in network
+		 * byte order. port is in host byte order.
+		 */
+		endpoint(family_type family, const unsigned char* address,
+				unsigned short port,
+				unsigned long scope_id = 0) :
+		fam(family),
+		prt(port),
+		scope(family == ipv6 ? scope_id : 0)
+		{
+			std::memset(addr, 0, sizeof(addr));
+			std::copy(address, address + size_of(family), addr);
+		}
+
+		family_type family() const
+		{
+			return fam;
+		}
+
+		bool empty() const
+		{
+			return fam == unspecified;
+		}
+
+		const unsigned char* address() const
+		{
+			return addr;
+		}
+
+		/* Returns 4 for ipv4, 16 for ipv6 and 0 otherwise. */
+		std::size_t address_size() const
+		{
+			return size_of(fam);
+		}
+
+		unsigned short port() const
+		{
+			return prt;
+		}
+
+		unsigned long scope_id() const
+		{
+			return scope;
+		}
+
+		std::size_t hash() const
+		{
+			std::size_t result(static_cast<std::size_t>(fam) * 31 +
+								prt);
+
+			for (std::size_t i = 0; i < sizeof(addr); ++i)
+				result = result * 131 + addr[i];
+			return result ^ scope;
+		}
+
+		/*
+		 * Writes the numeric address into s, followed by the port if
+		 * with_port is true ("192.0.2.1:80", "[2001:db8::1]:80"), and
+		 * terminates it with a null character. Returns the length, or 0
+		 * if the endpoint is empty or s, of n bytes, is too small.
+		 */
+		std::size_t format(char* s, std::size_t n,
+					bool with_port = true) const
+		{
+			char tmp[max_string];
+			char* p(tmp);
+
+			if (n != 0) *s = '\0';
+			if (fam == unspecified) return 0;
+			if (fam == ipv6 && with_port != false) *p++ = '[';
+			if (fam == ipv4)
+				p = format_ipv4(p, addr);
+			else
+				p = format_ipv6(p);
+			if (scope != 0) {
+				*p++ = '%';
+				p = format_number(p, scope);
+			}
+			if (with_port != false) {
+				if (fam == ipv6) *p++ = ']';
+				*p++ = ':';
+				p = format_number(p, prt);
+			}
+			if (static_cast<std::size_t>(p - tmp) >= n) return 0;
+			*std::copy(tmp, p, s) = '\0';
+			return static_cast<std::size_t>(p - tmp);
+		}
+
+		std::string to_string(bool with_port = true) const
+		{
+			char s[max_string];
+
+			return std::string(s, format(s, sizeof(s), with_port));
+		}
+
+		friend bool operator==(const endpoint& a, const endpoint& b)
+		{
+			return a.fam == b.fam && a.prt == b.prt &&
+				a.scope == b.scope &&
+				std::memcmp(a.addr, b.addr, sizeof(a.addr)) == 0;
+		}
+
+		friend bool operator!=(const endpoint& a, const endpoint& b)
+		{
+			return !(a == b);
+		}
+
+		friend bool operator<(const endpoint& a, const endpoint& b)
+		{
+			int c;
+
+			if (a.fam != b.fam) return a.fam < b.fam;
+			c = std::memcmp(a.addr, b.addr, sizeof(a.addr));
+			if (c != 0) return c < 0;
+			if (a.prt != b.prt) return a.prt < b.prt;
+			return a.scope < b.scope;
+		}
+	private:
+		static std::size_t size_of(family_type family)
+		{
+			return family == ipv4 ? 4 : family == ipv6 ? 16 : 0;
+		}
+
+		static char* format_number(char* p, unsigned long n)
+		{
+			char digits[24];
+			char* d(digits);
+
+			do {
+				*d++ = static_cast<char>('0' + n % 10);
+				n /= 10;
+			} while (n != 0);
+			while (d != digits) *p++ = *--d;
+			return p;
+		}
+
+		static char* format_ipv4(char* p, const unsigned char* a)
+		{
+			for (int i = 0; i < 4; ++i) {
+				if (i != 0) *p++ = '.';
+				p = format_number(p, a[i]);
+			}
+			return p;
+		}
+
+		/* RFC 5952 text form: lowercase, longest zero run as "::" */
+		char* format_ipv6(char* p) const
+		{
+			static const char hex[] = "0123456789abcdef";
+			unsigned g[8];
+			int run(-1), run_len(0), i, j;
+
+			for (i = 0; i < 8; ++i)
+				g[i] = (addr[2 * i] << 8) | addr[2 * i + 1];
+			for (i = 0; i < 8; i = j + 1) {
+				for (j = i; j < 8 && g[j] == 0; ++j) {}
+				if (j - i > run_len && j - i > 1) {
+					run = i;
+					run_len = j - i;
+				}
+			}
+			for (i = 0; i < 8; ++i) {
+				if (i == run) {
+					*p++ = ':';
+					if (i == 0) *p++ = ':';
+					i += run_len - 1;
+					/* IPv4-mapped addresses end in dotted form */
+					if (run == 0 && run_len == 5 &&
+							g[5] == 0xffff) {
+						std::memcpy(p, "ffff:", 5);
+						return format_ipv4(p + 5, addr + 12);
+					}
+					continue;
+				}
+				for (j = 12; j > 0 && (g[i] >> j) == 0; j -= 4) {}
+				for (; j >= 0; j -= 4)
+					*p++ = hex[(g[i] >> j) & 0xf];
+				if (i != 7) *p++ = ':';
+			}
+			return p;
+		}
+
+		family_type fam;
+		unsigned short prt;
+		unsigned long scope;
+		unsigned char addr[16];
+	};
+
+}
+
+#if __cplusplus >= 201103L
+namespace std {
+
+	template <>
+	struct hash<swoope::endpoint> {
+		std::size_t operator()(const swoope::endpoint& e) const
+		{
+			return e.hash();
+		}
+	};
+
+}
+#endif
+
+#endif
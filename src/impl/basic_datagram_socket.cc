@@ -0,0 +1,223 @@
+/*
+ * basic_datagram_socket.cc
+ */
+
+namespace swoope {
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>::
+	basic_datagram_socket() :
+	sock(socket_traits_type::invalid()),
+	buffers(0),
+	buffer_count(0),
+	buffer_size(0),
+	allocator(0),
+	blocked(false)
+	{
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>::
+	~basic_datagram_socket()
+	{
+		close();
+		free_buffers();
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	open(const std::string& host, const std::string& service)
+	{
+		if (is_open() != false) return 0;
+		sock = socket_traits_type::open_datagram(host, service);
+		return (is_open() != false) ? this : 0;
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	open(const std::string& service)
+	{
+		return open(std::string(), service);
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	close()
+	{
+		basic_datagram_socket* result(this);
+
+		if (is_open() == false) return 0;
+		if (socket_traits_type::close(sock) != 0) result = 0;
+		sock = socket_traits_type::invalid();
+		blocked = false;
+		return result;
+	}
+
+	template <class SocketTraits>
+	bool
+	basic_datagram_socket<SocketTraits>::
+	is_open() const
+	{
+		return sock != socket_traits_type::invalid();
+	}
+
+	template <class SocketTraits>
+	typename basic_datagram_socket<SocketTraits>::socket_type
+	basic_datagram_socket<SocketTraits>::
+	socket() const
+	{
+		return sock;
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	set_blocking(bool blocking)
+	{
+		if (is_open() == false ||
+			socket_traits_type::set_blocking(sock, blocking) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits>
+	bool
+	basic_datagram_socket<SocketTraits>::
+	would_block() const
+	{
+		return blocked;
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	set_option(const socket_option& option)
+	{
+		if (is_open() == false ||
+			socket_traits_type::set_option(sock, option) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	set_gro(bool on)
+	{
+		if (is_open() == false ||
+			socket_traits_type::set_gro(sock, on) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits>
+	std::size_t
+	basic_datagram_socket<SocketTraits>::
+	send(const datagram* d, std::size_t count)
+	{
+		std::size_t result(0);
+		int sent;
+
+		blocked = false;
+		if (is_open() == false) return result;
+		while (result < count) {
+			sent = socket_traits_type::send_datagrams(sock,
+						d + result, count - result);
+			if (sent < 0) {
+				blocked = socket_traits_type::would_block();
+				break;
+			}
+			result += static_cast<std::size_t>(sent);
+		}
+		return result;
+	}
+
+	template <class SocketTraits>
+	std::size_t
+	basic_datagram_socket<SocketTraits>::
+	receive(datagram* d, std::size_t count)
+	{
+		std::size_t result(0);
+		int got;
+
+		blocked = false;
+		if (is_open() == false) return result;
+		while (result < count) {
+			got = socket_traits_type::receive_datagrams(sock,
+					d + result, count - result, result == 0);
+			if (got < 0) {
+				if (result == 0)
+					blocked = socket_traits_type::
+								would_block();
+				break;
+			}
+			result += static_cast<std::size_t>(got);
+			/* A short batch means the queue is empty */
+			if (got < socket_traits_type::datagram_batch) break;
+		}
+		return result;
+	}
+
+	template <class SocketTraits>
+	basic_datagram_socket<SocketTraits>*
+	basic_datagram_socket<SocketTraits>::
+	set_receive_buffers(std::size_t count, std::size_t size,
+						socketbuf_allocator* a)
+	{
+		free_buffers();
+		if (count == 0) return this;
+		buffers = new datagram[count];
+		buffer_size = size;
+		allocator = a;
+		for (; buffer_count < count; ++buffer_count) {
+			datagram& d(buffers[buffer_count]);
+
+			d.data = (a != 0) ? a->allocate(size) : new char[size];
+			if (d.data == 0) {
+				free_buffers();
+				return 0;
+			}
+			d.capacity = size;
+		}
+		return this;
+	}
+
+	template <class SocketTraits>
+	std::size_t
+	basic_datagram_socket<SocketTraits>::
+	receive()
+	{
+		return receive(buffers, buffer_count);
+	}
+
+	template <class SocketTraits>
+	const datagram*
+	basic_datagram_socket<SocketTraits>::
+	received() const
+	{
+		return buffers;
+	}
+
+	template <class SocketTraits>
+	void
+	basic_datagram_socket<SocketTraits>::
+	free_buffers()
+	{
+		for (std::size_t i = 0; i < buffer_count; ++i) {
+			if (allocator != 0)
+				allocator->deallocate(buffers[i].data,
+								buffer_size);
+			else
+				delete[] buffers[i].data;
+		}
+		delete[] buffers;
+		buffers = 0;
+		buffer_count = 0;
+		buffer_size = 0;
+		allocator = 0;
+	}
+
+}
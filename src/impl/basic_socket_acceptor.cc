@@ -0,0 +1,141 @@
+/*
+ * basic_socket_acceptor.cc
+ */
+
+namespace swoope {
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	basic_socket_acceptor() :
+	listeners(),
+	threads(),
+	stopping(false)
+	{
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	~basic_socket_acceptor()
+	{
+		close();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	is_open() const
+	{
+		return listeners.empty() == false;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_acceptor<SocketTraits, BufferPolicy>*
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	open(const std::string& service, int backlog, std::size_t count,
+					const listener_options& options)
+	{
+		listener_options o(options);
+
+		if (is_open() != false) return 0;
+		if (count == 0) count = std::thread::hardware_concurrency();
+		if (count == 0) count = 1;
+		o.reuse_port = true;
+		for (std::size_t i = 0; i < count; ++i) {
+			/* Group order decides which listener a CPU steers to */
+			o.incoming_cpu = static_cast<int>(i);
+			listeners.push_back(new socketbuf_type());
+			if (listeners.back()->open(service, backlog, o) == 0) {
+				close();
+				return 0;
+			}
+		}
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	size() const
+	{
+		return listeners.size();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	typename basic_socket_acceptor<SocketTraits, BufferPolicy>::
+							socketbuf_type&
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	listener(std::size_t index)
+	{
+		return *listeners[index];
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_acceptor<SocketTraits, BufferPolicy>*
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	start(handler& h, bool pin)
+	{
+		if (is_open() == false || threads.empty() == false) return 0;
+		stopping = false;
+		for (std::size_t i = 0; i < listeners.size(); ++i)
+			threads.push_back(std::thread(
+					&basic_socket_acceptor::serve, this,
+					i, &h, pin));
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	close()
+	{
+		stopping = true;
+		/* Shutting a listener down wakes a thread blocked in accept */
+		for (std::size_t i = 0; i < listeners.size(); ++i)
+			listeners[i]->shutdown(std::ios_base::in);
+		for (std::size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+		threads.clear();
+		for (std::size_t i = 0; i < listeners.size(); ++i)
+			delete listeners[i];
+		listeners.clear();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_acceptor<SocketTraits, BufferPolicy>::
+	serve(std::size_t index, handler* h, bool pin)
+	{
+		socketbuf_type client;
+		cpu_set_t cpus;
+		std::chrono::milliseconds backoff(0);
+
+		if (pin != false) {
+			CPU_ZERO(&cpus);
+			CPU_SET(index % CPU_SETSIZE, &cpus);
+			::pthread_setaffinity_np(::pthread_self(),
+						sizeof(cpus), &cpus);
+		}
+		while (stopping == false) {
+			if (listeners[index]->accept(client) == 0) {
+				/*
+				 * Out of descriptors or memory, accept keeps
+				 * failing until something is freed, so back off
+				 * instead of spinning.
+				 */
+				if (errno == EINTR || errno == ECONNABORTED ||
+					listeners[index]->would_block() != false) {
+					std::this_thread::yield();
+				} else {
+					backoff = std::min(std::max(backoff * 2,
+						std::chrono::milliseconds(1)),
+						std::chrono::milliseconds(50));
+					std::this_thread::sleep_for(backoff);
+				}
+				continue;
+			}
+			backoff = std::chrono::milliseconds(0);
+			h->accepted(client, index);
+		}
+	}
+
+}
@@ -0,0 +1,172 @@
+/*
+ * basic_socket_pool.cc
+ */
+
+namespace swoope {
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	basic_socket_pool(std::size_t per_key,
+			clock_type::duration timeout,
+			const connect_options& connect) :
+	max_per_key(per_key),
+	idle_timeout(timeout),
+	options(connect),
+	buckets(),
+	lock()
+	{
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	~basic_socket_pool()
+	{
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	acquire(const std::string& host, const std::string& service,
+							stream_type& s)
+	{
+		key_type key(host, service);
+		std::unique_lock<std::mutex> g(lock);
+		bucket& b(buckets[key]);
+		clock_type::time_point now(clock_type::now());
+
+		if (s.is_open() != false) s.close();
+		/* The most recently used connection is the likeliest alive */
+		while (b.idle.empty() == false) {
+			connection& c(b.idle.back());
+
+			if (now - c.since < idle_timeout &&
+						alive(c.stream) != false) {
+				s = std::move(c.stream);
+				b.idle.pop_back();
+				return true;
+			}
+			b.idle.pop_back();
+			--b.open;
+		}
+		if (b.open >= max_per_key) return false;
+		++b.open;
+		g.unlock();
+		s.clear();
+		s.open(host, service, options);
+		if (s.is_open() != false) return true;
+		g.lock();
+		forget(key);
+		return false;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	release(const std::string& host, const std::string& service,
+							stream_type& s)
+	{
+		key_type key(host, service);
+		bool reuse(s.is_open() != false);
+
+		if (reuse != false) {
+			s.push();
+			reuse = s.good() && s.rdbuf()->in_avail() == 0;
+		}
+		if (reuse == false && s.is_open() != false) s.close();
+
+		std::lock_guard<std::mutex> g(lock);
+
+		if (reuse == false) {
+			forget(key);
+			return;
+		}
+		bucket& b(buckets[key]);
+		b.idle.push_back(connection());
+		b.idle.back().stream = std::move(s);
+		b.idle.back().since = clock_type::now();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	purge()
+	{
+		std::lock_guard<std::mutex> g(lock);
+		clock_type::time_point now(clock_type::now());
+		typename bucket_map::iterator i;
+		std::size_t result(0);
+
+		for (i = buckets.begin(); i != buckets.end(); ) {
+			bucket& b(i->second);
+
+			/* Idle connections are ordered from oldest to newest */
+			while (b.idle.empty() == false &&
+				now - b.idle.front().since >= idle_timeout) {
+				b.idle.pop_front();
+				--b.open;
+				++result;
+			}
+			if (b.open == 0)
+				buckets.erase(i++);
+			else
+				++i;
+		}
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	idle() const
+	{
+		std::lock_guard<std::mutex> g(lock);
+		typename bucket_map::const_iterator i;
+		std::size_t result(0);
+
+		for (i = buckets.begin(); i != buckets.end(); ++i)
+			result += i->second.idle.size();
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	size() const
+	{
+		std::lock_guard<std::mutex> g(lock);
+		typename bucket_map::const_iterator i;
+		std::size_t result(0);
+
+		for (i = buckets.begin(); i != buckets.end(); ++i)
+			result += i->second.open;
+		return result;
+	}
+
+	/*
+	 * An idle connection should have nothing to read. If it is readable,
+	 * the peer has closed it or sent something unexpected.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	alive(stream_type& s)
+	{
+		socket_type sock(s.rdbuf()->socket());
+		std::ios_base::openmode in(std::ios_base::in), ready;
+
+		return socket_traits_type::poll(&sock, &in, &ready, 1, 0) == 0;
+	}
+
+	/* Drops the count of a connection that was closed */
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_pool<SocketTraits, BufferPolicy>::
+	forget(const key_type& key)
+	{
+		typename bucket_map::iterator i(buckets.find(key));
+
+		if (i == buckets.end() || i->second.open == 0) return;
+		if (--i->second.open == 0) buckets.erase(i);
+	}
+
+}
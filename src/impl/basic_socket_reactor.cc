@@ -0,0 +1,207 @@
+/*
+ * basic_socket_reactor.cc
+ */
+
+namespace swoope {
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	basic_socket_reactor() :
+	poller(poller_type::open()),
+	registry(),
+	retired(),
+	stopped(false),
+	wheel(),
+	last_tick(SocketTraits::monotonic_time())
+	{
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	~basic_socket_reactor()
+	{
+		typename registry_type::iterator i;
+
+		for (i = registry.begin(); i != registry.end(); ++i)
+			delete i->second;
+		registry.clear();
+		purge();
+		if (is_open() != false)
+			poller_type::close(poller);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	is_open() const
+	{
+		return poller != poller_type::invalid();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_reactor<SocketTraits, BufferPolicy>*
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	add(socketbuf_type& sb, handler& h, int events)
+	{
+		registration* r;
+		typename registry_type::iterator i;
+
+		if (is_open() == false || sb.is_open() == false) return 0;
+		if (sb.set_blocking(false) == 0) return 0;
+		i = registry.find(&sb);
+		if (i != registry.end()) {
+			i->second->h = &h;
+			if (poller_type::modify(poller, sb.socket(), events,
+							i->second) == 0)
+				return this;
+			retire(i->second);
+			registry.erase(i);
+		}
+		r = new registration();
+		r->sb = &sb;
+		r->h = &h;
+		if (poller_type::add(poller, sb.socket(), events, r) != 0) {
+			delete r;
+			return 0;
+		}
+		registry[&sb] = r;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_reactor<SocketTraits, BufferPolicy>*
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	modify(socketbuf_type& sb, int events)
+	{
+		typename registry_type::iterator i((registry.find(&sb)));
+
+		if (i == registry.end()) return 0;
+		if (poller_type::modify(poller, sb.socket(), events,
+							i->second) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_reactor<SocketTraits, BufferPolicy>*
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	remove(socketbuf_type& sb)
+	{
+		typename registry_type::iterator i((registry.find(&sb)));
+
+		if (i == registry.end()) return 0;
+		/*
+		 * Closing the socket already removed it from the poller, so a
+		 * failure here is not an error.
+		 */
+		if (sb.is_open() != false)
+			poller_type::remove(poller, sb.socket());
+		retire(i->second);
+		registry.erase(i);
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	size() const
+	{
+		return registry.size();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	timing_wheel&
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	timers()
+	{
+		return wheel;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	int
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	run_once(int timeout)
+	{
+		typename poller_type::event_type evs[64];
+		registration* r;
+		std::size_t expired;
+		long next;
+		int result;
+
+		if (is_open() == false) return -1;
+		expired = expire_timers();
+		next = wheel.next_timeout();
+		if (expired != 0)
+			timeout = 0;
+		else if (next != -1 && (timeout < 0 || next < timeout))
+			timeout = static_cast<int>(next);
+		result = poller_type::wait(poller, evs, 64, timeout);
+		for (int i = 0; i < result; ++i) {
+			r = static_cast<registration*>(poller_type::data(
+								evs[i]));
+			/* Skip registrations removed by an earlier handler */
+			if (r->sb != 0)
+				r->h->ready(*r->sb, poller_type::events(evs[i]));
+		}
+		purge();
+		if (result < 0) return result;
+		expired += expire_timers();
+		purge();
+		return result + static_cast<int>(expired);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	run()
+	{
+		stopped = false;
+		while (stopped == false && (registry.empty() == false ||
+						wheel.size() != 0)) {
+			if (run_once(-1) < 0) break;
+		}
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	stop()
+	{
+		stopped = true;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	retire(registration* r)
+	{
+		r->sb = 0;
+		r->h = 0;
+		retired.push_back(r);
+	}
+
+	/* Advances the wheel to the current millisecond */
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	expire_timers()
+	{
+		long now(SocketTraits::monotonic_time());
+		timing_wheel::tick_type ticks(static_cast<
+				timing_wheel::tick_type>(now - last_tick));
+
+		last_tick = now;
+		return wheel.advance(ticks);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socket_reactor<SocketTraits, BufferPolicy>::
+	purge()
+	{
+		for (std::size_t i = 0; i < retired.size(); ++i)
+			delete retired[i];
+		retired.clear();
+	}
+
+}
@@ -0,0 +1,126 @@
+/*
+ * basic_socket_relay.cc
+ */
+
+namespace swoope {
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	basic_socket_relay()
+	{
+		pipes[0][0] = pipes[0][1] = -1;
+		pipes[1][0] = pipes[1][1] = -1;
+		staged[0] = staged[1] = 0;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	~basic_socket_relay()
+	{
+		socket_traits_type::close_pipe(pipes[0]);
+		socket_traits_type::close_pipe(pipes[1]);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	forward(socketbuf_type& src, socketbuf_type& dst)
+	{
+		std::streamsize got, result(0);
+
+		if (src.is_open() == false || dst.is_open() == false)
+			return -1;
+		/* What an earlier call left staged came before src's buffer */
+		if (staged[0] != 0 && (result = step(src, dst, 0)) < 0)
+			return -1;
+		if ((got = drain(src, dst)) < 0) return -1;
+		result += got;
+		while ((got = step(src, dst, 0)) > 0)
+			result += got;
+		if (got < 0) return -1;
+		if (dst.shutdown(std::ios_base::out) == 0) return -1;
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socket_relay<SocketTraits, BufferPolicy>*
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	run(socketbuf_type& a, socketbuf_type& b)
+	{
+		socketbuf_type* from[2] = { &a, &b };
+		socketbuf_type* to[2] = { &b, &a };
+		socket_type sockets[2];
+		std::ios_base::openmode events[2], ready[2];
+		bool open[2] = { true, true };
+		std::streamsize got;
+
+		if (a.is_open() == false || b.is_open() == false) return 0;
+		for (int i = 0; i < 2; ++i)
+			if (staged[i] != 0 && step(*from[i], *to[i], i) < 0)
+				return 0;
+		if (drain(a, b) < 0 || drain(b, a) < 0) return 0;
+		while (open[0] != false || open[1] != false) {
+			int count(0);
+
+			for (int i = 0; i < 2; ++i) {
+				if (open[i] == false) continue;
+				sockets[count] = from[i]->socket();
+				events[count] = std::ios_base::in;
+				++count;
+			}
+			if (socket_traits_type::poll(sockets, events, ready,
+							count, -1) < 0)
+				return 0;
+			for (int i = 0, j = 0; i < 2; ++i) {
+				if (open[i] == false) continue;
+				if ((ready[j++] & std::ios_base::in) == 0)
+					continue;
+				got = step(*from[i], *to[i], i);
+				if (got < 0) return 0;
+				if (got == 0) {
+					open[i] = false;
+					if (to[i]->shutdown(std::ios_base::out)
+									== 0)
+						return 0;
+				}
+			}
+		}
+		return this;
+	}
+
+	/*
+	 * Sends whatever src has already buffered to dst and flushes dst, so
+	 * that spliced bytes follow it in order. Returns the number of bytes
+	 * sent, or -1 on error.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	drain(socketbuf_type& src, socketbuf_type& dst)
+	{
+		char buf[BUFSIZ];
+		std::streamsize avail, got, result(0);
+
+		while ((avail = src.in_avail()) > 0) {
+			got = src.sgetn(buf, std::min(avail,
+				static_cast<std::streamsize>(sizeof(buf))));
+			if (dst.sputn(buf, got) != got) return -1;
+			result += got;
+		}
+		if (dst.push() == 0) return -1;
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socket_relay<SocketTraits, BufferPolicy>::
+	step(socketbuf_type& src, socketbuf_type& dst, int i)
+	{
+		if (pipes[i][0] == -1 &&
+				socket_traits_type::open_pipe(pipes[i]) != 0)
+			return -1;
+		return socket_traits_type::splice(src.socket(), dst.socket(),
+						pipes[i], 65536, staged[i]);
+	}
+
+}
@@ -6,8 +6,8 @@
 
 namespace swoope {
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	basic_socketbuf() :
 	__streambuf_type(),
 	__socketbuf_base_type()
@@ -15,8 +15,8 @@ namespace swoope {
 	}
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	basic_socketbuf(basic_socketbuf&& rhs) :
 	__streambuf_type(),		
 	__socketbuf_base_type()
@@ -25,8 +25,8 @@ namespace swoope {
 	}
 #endif
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	~basic_socketbuf()
 	{
 		try {
@@ -35,9 +35,9 @@ namespace swoope {
 	}
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>&
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>&
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	operator=(basic_socketbuf&& rhs)
 	{
 		close();
@@ -46,27 +46,38 @@ namespace swoope {
 		return *this;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	void 
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	swap(basic_socketbuf& rhs)
 	{
+		char_type *lhs_base(this->base), *rhs_base(rhs.base);
+		char_type *lhs_own(own_storage()), *rhs_own(rhs.own_storage());
+
 		__streambuf_type::swap(rhs);
 		__socketbuf_base_type::swap(rhs);
+		/*
+		 * Areas that lived inside the other object had their contents
+		 * swapped along with it, so point at them there.
+		 */
+		if (rhs_base != 0 && rhs_base == rhs_own)
+			relocate(rhs_own, lhs_own);
+		if (lhs_base != 0 && lhs_base == lhs_own)
+			rhs.relocate(lhs_own, rhs_own);
 	}
 #endif
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	bool
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	is_open() const
 	{
 		return this->__socketbuf_base_type::is_open;
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	open(socket_type socket, std::ios_base::openmode m)
 	{
 		if (is_open() != false) return 0;
@@ -74,110 +85,517 @@ namespace swoope {
 		this->__socketbuf_base_type::socket = socket;
 		this->mode = m;
 		this->__socketbuf_base_type::is_open = true;
+		/* Time limits are kept with non-blocking I/O and poll */
+		if (timed() != false && this->nonblocking == false)
+			socket_traits_type::set_blocking(socket, false);
 		return this;
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	open(const std::string& host, const std::string& service,
 					std::ios_base::openmode m)
 	{
 		if (is_open() != false) return 0;
+		if (this->preset_options.empty() == false ||
+					this->connect_timeout >= 0)
+			return open(host, service, connect_options(), m);
 		return open(socket_traits_type::open(host, service), m);
 	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	open(const std::string& host, const std::string& service,
+		const connect_options& options, std::ios_base::openmode m)
+	{
+		connect_options o(options);
+		basic_socketbuf* result;
+
+		if (is_open() != false) return 0;
+		o.socket_options.insert(o.socket_options.begin(),
+					this->preset_options.begin(),
+					this->preset_options.end());
+		if (o.timeout < 0) o.timeout = this->connect_timeout;
+		result = open(socket_traits_type::open(host, service, o), m);
+		this->expired = result == 0 &&
+				socket_traits_type::timed_out() != false;
+		return result;
+	}
 	
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	open(const std::string& service, int backlog)
 	{
 		if (is_open() != false) return 0;
+		if (this->preset_options.empty() == false)
+			return open(service, backlog, listener_options());
 		return open(socket_traits_type::open(service, backlog), 
 				std::ios_base::in | std::ios_base::out);
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	open(const std::string& service, int backlog,
+				const listener_options& options)
+	{
+		listener_options o(options);
+
+		if (is_open() != false) return 0;
+		o.socket_options.insert(o.socket_options.begin(),
+					this->preset_options.begin(),
+					this->preset_options.end());
+		return open(socket_traits_type::open(service, backlog, o),
+				std::ios_base::in | std::ios_base::out);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	accept(basic_socketbuf& d_socketbuf)
+	{
+		return accept(d_socketbuf, this->nonblocking);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	accept(basic_socketbuf& d_socketbuf, bool nb)
 	{
 		socket_type invalid_socket(socket_traits_type::invalid()),
 						server_socket(socket()),
 						client_socket;
+		address_type peer;
 		if (d_socketbuf.is_open() != false)
 			d_socketbuf.close();
-		client_socket = socket_traits_type::accept(server_socket);
-		if (client_socket == invalid_socket) return 0;
+		if (d_socketbuf.allocator == 0)
+			d_socketbuf.allocator = this->allocator;
+		if (this->idle_release != false)
+			d_socketbuf.idle_release = true;
+		d_socketbuf.flush_mode = this->flush_mode;
+		d_socketbuf.flush_delay = this->flush_delay;
+		d_socketbuf.connect_timeout = this->connect_timeout;
+		d_socketbuf.read_timeout = this->read_timeout;
+		d_socketbuf.write_timeout = this->write_timeout;
+		this->blocked = false;
+		arm();
+		do {
+			client_socket = socket_traits_type::accept(server_socket,
+				peer, nb || d_socketbuf.timed());
+		} while (client_socket == invalid_socket &&
+					retry(std::ios_base::in) != false);
+		if (client_socket == invalid_socket) {
+			this->blocked = socket_traits_type::would_block();
+			return 0;
+		}
 		if (d_socketbuf.open(client_socket, std::ios_base::in |
 						std::ios_base::out) == 0)
 			return 0;
+		d_socketbuf.remote_ep = socket_traits_type::to_endpoint(peer);
+		d_socketbuf.remote_known = true;
+		d_socketbuf.nonblocking = nb;
 		return this;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	accept_many(basic_socketbuf* d, std::size_t max)
+	{
+		bool nb(this->nonblocking), restore(false);
+		std::size_t result(0);
+
+		while (result < max) {
+			if (accept(d[result], nb) == 0) break;
+			++result;
+			/*
+			 * A blocking socket is switched to non-blocking mode
+			 * after the first connection, so that the backlog is
+			 * drained without waiting.
+			 */
+			if (this->nonblocking == false) {
+				if (result == max || set_blocking(false) == 0)
+					break;
+				restore = true;
+			}
+		}
+		if (restore != false) set_blocking(true);
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
 	std::string
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	local_address() const
 	{
-		return socket_traits_type::local_address(socket());
+		return local_endpoint().to_string(false);
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	std::string
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	remote_address() const
 	{
-		return socket_traits_type::remote_address(socket());
+		return remote_endpoint().to_string(false);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	const endpoint&
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	local_endpoint() const
+	{
+		if (this->local_known == false && is_open() != false) {
+			this->local_ep = socket_traits_type::local_endpoint(
+								socket());
+			this->local_known = true;
+		}
+		return this->local_ep;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	const endpoint&
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	remote_endpoint() const
+	{
+		if (this->remote_known == false && is_open() != false) {
+			this->remote_ep = socket_traits_type::remote_endpoint(
+								socket());
+			this->remote_known = true;
+		}
+		return this->remote_ep;
 	}
 	
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::shutdown(std::ios_base::openmode m)
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	shutdown(std::ios_base::openmode m)
 	{
 		basic_socketbuf* result((this));
 
 		if (is_open() == false) return 0;
-		if (sync() == -1) result = 0;
+		if (push() == 0) result = 0;
 		if (socket_traits_type::shutdown(this->__socketbuf_base_type::
 							socket, m) != 0)
 			result = 0;
 		return result;
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::close()
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::close()
 	{
 		using std::swap;
 		basic_socketbuf* result((this));
 		socket_type invalid((socket_traits_type::invalid()));
 
 		if (is_open() == false) return 0;
-		if (sync() == -1) result = 0;
+		if (push() == 0) result = 0;
 		if (socket_traits_type::close(this->__socketbuf_base_type::
 								socket) != 0)
 			result = 0;
 		swap(this->__socketbuf_base_type::socket, invalid);	
 		this->setg(0, 0, 0);
 		this->setp(0, 0);
+		if (this->base_allocator != 0) this->reset_base(0, false);
 		this->__socketbuf_base_type::is_open = false;
+		this->local_ep = endpoint();
+		this->remote_ep = endpoint();
+		this->local_known = false;
+		this->remote_known = false;
+		this->gafull = false;
+		this->nonblocking = false;
+		this->blocked = false;
+		this->zerocopy_threshold = 0;
+		this->zerocopy_sent = 0;
+		this->zerocopy_done = 0;
+		this->zerocopy_early.clear();
 		return result;
 	}
 
-	template <class SocketTraits>
-	typename basic_socketbuf<SocketTraits>::socket_type
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	typename basic_socketbuf<SocketTraits, BufferPolicy>::socket_type
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	socket() const
 	{
 		return this->__socketbuf_base_type::socket;
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf<SocketTraits>*
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_blocking(bool blocking)
+	{
+		if (is_open() == false) return 0;
+		/* Accepted sockets may already be non-blocking */
+		if (blocking == false && this->nonblocking != false) return this;
+		if (socket_traits_type::set_blocking(socket(), blocking &&
+						timed() == false) != 0)
+			return 0;
+		this->nonblocking = !blocking;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	would_block() const
+	{
+		return this->blocked;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_zerocopy(std::streamsize threshold, bool wait)
+	{
+		if (is_open() == false) return 0;
+		if (threshold > 0 && socket_traits_type::set_zerocopy(
+						socket(), true) != 0)
+			return 0;
+		this->zerocopy_threshold = std::max(threshold,
+					static_cast<std::streamsize>(0));
+		this->zerocopy_wait = wait;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	unsigned
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	zerocopy_sequence() const
+	{
+		return this->zerocopy_sent;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	zerocopy_complete(unsigned seq)
+	{
+		unsigned first, last;
+
+		while (this->zerocopy_done != this->zerocopy_sent &&
+			socket_traits_type::zerocopy_completion(socket(),
+						first, last, false) == 1)
+			zerocopy_record(first, last);
+		/* Sequence numbers wrap around like the kernel's */
+		return static_cast<int>(this->zerocopy_done - seq) >= 0;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	zerocopy_flush()
+	{
+		unsigned first, last;
+
+		if (is_open() == false) return 0;
+		while (this->zerocopy_done != this->zerocopy_sent) {
+			if (socket_traits_type::zerocopy_completion(socket(),
+						first, last, true) != 1)
+				return 0;
+			zerocopy_record(first, last);
+		}
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	send_file(int fd, off_t offset, std::size_t length)
+	{
+		std::streamsize put, result(0);
+
+		if (is_open() == false) return result;
+		if ((this->mode & std::ios_base::out) == 0) return result;
+		if (push() == 0) return result;
+		this->blocked = false;
+		arm();
+		while (static_cast<std::size_t>(result) < length) {
+			put = socket_traits_type::send_file(socket(), fd,
+				offset + static_cast<off_t>(result),
+				length - static_cast<std::size_t>(result));
+			if (put < 0 && retry(std::ios_base::out) != false)
+				continue;
+			if (put <= 0) {
+				if (put < 0)
+					this->blocked = socket_traits_type::
+							would_block();
+				break;
+			}
+			result += put;
+		}
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	send_descriptors(const int* fds, std::size_t count,
+				const char_type* s, std::streamsize n)
+	{
+		std::streamsize put;
+
+		if (is_open() == false || n < 1) return 0;
+		if ((this->mode & std::ios_base::out) == 0) return 0;
+		if (push() == 0) return 0;
+		this->blocked = false;
+		arm();
+		do {
+			put = socket_traits_type::write_descriptors(socket(), s,
+								n, fds, count);
+		} while (put < 0 && retry(std::ios_base::out) != false);
+		if (put < 0) {
+			this->blocked = socket_traits_type::would_block();
+			return 0;
+		}
+		/* The descriptors went with the first byte */
+		if (put < n && write(s + put, n - put) != n - put) return 0;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::size_t
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	receive_descriptors(int* fds, std::size_t max)
+	{
+		if (is_open() == false) return 0;
+		return socket_traits_type::take_descriptors(socket(), fds, max);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_buffer_sizes(std::streamsize gsize, std::streamsize psize)
+	{
+		if (BufferPolicy::is_inline != false) return 0;
+		if (gsize < 1 || psize < 0) return 0;
+		if (this->gptr() != 0 && this->egptr() - this->gptr() > gsize)
+			return 0;
+		if (this->pptr() != 0 && this->pptr() - this->pbase() > psize &&
+								push() == 0)
+			return 0;
+		if (resize(gsize, psize) == false) return 0;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_input_growth(std::streamsize max)
+	{
+		this->gamax = std::max(max, static_cast<std::streamsize>(0));
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_allocator(socketbuf_allocator* a)
+	{
+		this->allocator = a;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_idle_release(bool release)
+	{
+		this->idle_release = release;
+		if (release != false) release_idle();
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_option(const socket_option& option)
+	{
+		if (is_open() == false) {
+			this->preset_options.push_back(option);
+			return this;
+		}
+		if (socket_traits_type::set_option(socket(), option) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	get_option(socket_option::name_type name, int& value)
+	{
+		socket_option option(name, 0);
+
+		if (is_open() == false) return 0;
+		if (socket_traits_type::get_option(socket(), option) != 0)
+			return 0;
+		value = option.value;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_flush_policy(flush_policy policy, long delay)
+	{
+		this->flush_mode = policy;
+		this->flush_delay = std::max(delay, 0L);
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	set_timeouts(long connect, long read, long write)
+	{
+		this->connect_timeout = std::max(connect, -1L);
+		this->read_timeout = std::max(read, -1L);
+		this->write_timeout = std::max(write, -1L);
+		if (is_open() != false && this->nonblocking == false &&
+			socket_traits_type::set_blocking(socket(),
+						timed() == false) != 0)
+			return 0;
+		return this;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	timed_out() const
+	{
+		return this->expired;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	push()
+	{
+		int_type eof((traits_type::eof()));
+		basic_socketbuf* result(this);
+
+		arm();
+		if (this->pptr() != 0 && overflow(eof) == eof) result = 0;
+		/* Uncorking sends what the system held back */
+		if (this->flush_since != -1) {
+			this->flush_since = -1;
+			if (socket_traits_type::set_cork(socket(), false) != 0)
+				result = 0;
+		}
+		if (result != 0) release_idle();
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf<SocketTraits, BufferPolicy>*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	setbuf(char_type* s, std::streamsize n)
 	{
+		if (BufferPolicy::is_inline != false) return 0;
 		if (s != 0) {
 			if (n < 1) return 0;
 			this->reset_base(s, false);
@@ -186,8 +604,15 @@ namespace swoope {
 				this->reset_base(&this->buf[0], false);
 				n = 1;
 			} else {
-				this->reset_base(new char_type[static_cast<
-						std::size_t>(n)], true);
+				s = this->allocate_base(static_cast<
+							std::size_t>(n));
+				if (s != 0) {
+					this->reset_base(s, true, static_cast<
+							std::size_t>(n));
+				} else {
+					this->reset_base(&this->buf[0], false);
+					n = 1;
+				}
 			}
 		}
 
@@ -198,46 +623,86 @@ namespace swoope {
 		return this;
 	}
 
-	template <class SocketTraits>
+	/*
+	 * Output that a non-blocking socket could not take stays in the put
+	 * area and is not an error, so that a stream flush leaves the stream
+	 * good with would_block() set.
+	 */
+	template <class SocketTraits, class BufferPolicy>
 	int
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	sync()
 	{
 		int_type eof((traits_type::eof()));
 		int result(0);
-		
-		if (this->pptr() != 0)
-			result = (overflow(eof) != eof) ? 0 : -1;
+
+		if (this->pptr() != this->pbase() && defer_flush() != false) {
+			if (this->flush_mode == flush_explicit) return result;
+			/* Into the corked socket, where the system bounds the wait */
+			arm();
+			if (overflow(eof) == eof && retained() == false)
+				result = -1;
+			return result;
+		}
+		if (push() == 0 && retained() == false) result = -1;
 		return result;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	std::streamsize
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	xsgetn(char_type* s, std::streamsize n)
 	{
-		
-		std::streamsize result(0), avail;
+		std::streamsize result(0), avail, got;
 
 		if (is_open() == false) return result;
 		if ((this->mode & std::ios_base::in) == 0) return result;
-		if (this->gptr() == 0) init_io();
+		if (this->flush_since != -1) push();
+		arm();
+		if ((got = read_queued()) >= 0) {
+			if (got == 0) return result;
+			this->setg(this->eback(), this->eback(),
+						this->eback() + got);
+			this->gafull = got == get_area_size();
+		} else if (this->gptr() == 0) {
+			if (wait_input() == false) return result;
+			init_io();
+		}
 		avail = this->egptr() - this->gptr();
 		if (avail >= n) {
 			std::copy(this->gptr(), this->gptr() + n, s); 
 			this->gbump(static_cast<std::size_t>(n));
 			result = n;
 		} else {
+			/*
+			 * Read the rest of the request straight into s and refill
+			 * the get area with whatever else is queued, in one call.
+			 * A short read is completed with a receive-all so that
+			 * exactly n bytes are returned unless the peer stops.
+			 */
 			s = std::copy(this->gptr(), this->gptr() + avail, s);
-			this->gbump(static_cast<std::size_t>(avail));
-			result = avail + read(s, n - avail);
+			n -= avail;
+			got = read(s, n, this->eback(), get_area_size());
+			if (got > n) {
+				this->setg(this->eback(), this->eback(),
+						this->eback() + (got - n));
+				this->gafull = got - n == get_area_size();
+				got = n;
+			} else {
+				this->setg(this->eback(), this->eback(),
+							this->eback());
+				if (got > 0 && got < n &&
+						this->nonblocking == false)
+					got += read_all(s + got, n - got);
+			}
+			result = avail + got;
 		}
 		return result;
 	}
 
-	template <class SocketTraits>
-	typename basic_socketbuf<SocketTraits>::int_type
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	typename basic_socketbuf<SocketTraits, BufferPolicy>::int_type
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	underflow()
 	{
 		int_type result((traits_type::eof()));
@@ -245,43 +710,87 @@ namespace swoope {
 
 		if (is_open() == false) return result;
 		if ((this->mode & std::ios_base::in) == 0) return result;
-		if (this->gptr() == 0) init_io();
-		got = read(this->eback(), this->gasize);
+		if (this->flush_since != -1) push();
+		arm();
+		if ((got = read_queued()) < 0) {
+			if (this->gptr() == 0) {
+				if (wait_input() == false) return result;
+				init_io();
+			}
+			if (this->gafull != false && this->gasize < this->gamax)
+				resize(std::min(this->gasize * 2, this->gamax),
+								this->pasize);
+			got = read(this->eback(), get_area_size());
+		}
+		this->gafull = got == get_area_size();
 		if (got > 0) {
 			this->setg(this->eback(), this->eback(), 
 						this->eback() + got);
-			result = *this->gptr();
+			result = traits_type::to_int_type(*this->gptr());
 		}
 		return result;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	std::streamsize
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	xsputn(const char_type* s, std::streamsize n)
 	{
-		int_type eof((traits_type::eof()));
 		std::streamsize result(0), pending, put;
 
 		if (is_open() == false) return result;
 		if ((this->mode & std::ios_base::out) == 0) return result;
 		if (this->pptr() == 0) init_io();
+		arm();
 		pending = this->pptr() - this->pbase();
-		if (pending + n <= this->pasize) {
+		if (pending + n <= put_area_size()) {
 			std::copy(s, s + n, this->pptr());
 			this->pbump(static_cast<std::size_t>(n));
 			result += n;	
+		} else if (this->zerocopy_threshold != 0 &&
+					n >= this->zerocopy_threshold) {
+			if (pending != 0 && overflow(traits_type::eof()) ==
+							traits_type::eof())
+				return result;
+			result = write_zerocopy(s, n);
+		} else if (put_area_size() == 0) {
+			result = write(s, n);
 		} else {
-			if (overflow(eof) != 0) return result;
+			/*
+			 * Send the pending bytes together with the full multiples
+			 * of pasize from s in one gather write, then buffer the
+			 * remainder.
+			 */
 			std::ldiv_t d((std::div(static_cast<long int>(n),
-					static_cast<long int>(this->pasize))));
-			if (d.quot > 0) {
-				d.quot *= static_cast<long int>(this->pasize);
-				put = write(s, d.quot);
-				if (put < d.quot) return put;
-				s += put;
-				result += put;
+					static_cast<long int>(put_area_size()))));
+			d.quot *= static_cast<long int>(put_area_size());
+			put = write(this->pbase(), pending, s, d.quot,
+					this->flush_mode == flush_coalesce);
+			if (put < pending + d.quot && this->blocked != false) {
+				/*
+				 * Keep whatever was not sent and buffer as much of
+				 * s as still fits.
+				 */
+				if (put < pending) {
+					retain(put);
+					put = 0;
+				} else {
+					this->pbump(static_cast<std::size_t>(
+								-pending));
+					put -= pending;
+				}
+				n = std::min(n - put, static_cast<std::streamsize>(
+						this->epptr() - this->pptr()));
+				std::copy(s + put, s + put + n, this->pptr());
+				this->pbump(static_cast<std::size_t>(n));
+				return put + n;
 			}
+			this->pbump(static_cast<std::size_t>(-pending));
+			if (put < pending + d.quot)
+				return std::max(put - pending,
+						static_cast<std::streamsize>(0));
+			s += d.quot;
+			result += d.quot;
 			std::copy(s, s + d.rem, this->pbase());
 			this->pbump(static_cast<std::size_t>(d.rem));
 			result += d.rem;
@@ -289,9 +798,9 @@ namespace swoope {
 		return result;
 	}
 
-	template <class SocketTraits>
-	typename basic_socketbuf<SocketTraits>::int_type
-	basic_socketbuf<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	typename basic_socketbuf<SocketTraits, BufferPolicy>::int_type
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	overflow(int_type c)
 	{
 		int_type result((traits_type::eof()));
@@ -300,6 +809,7 @@ namespace swoope {
 		if (is_open() == false) return result;
 		if ((this->mode & std::ios_base::out) == 0) return result;
 		if (this->pptr() == 0) init_io();
+		arm();
 		if (this->pptr() < this->epptr() && c != result)
 			return this->sputc(traits_type::to_char_type(c));
 		if (this->pbase() == this->epptr()) {
@@ -315,7 +825,16 @@ namespace swoope {
 			if (pending == 0) {
 				put = 0;
 			} else {
-				put = write(this->pbase(), pending);
+				put = write(this->pbase(), pending, c != result &&
+					this->flush_mode == flush_coalesce);
+				if (put < pending && this->blocked != false) {
+					retain(put);
+					if (c != result && this->pptr() <
+							this->epptr())
+						result = this->sputc(traits_type::
+							to_char_type(c));
+					return result;
+				}
 				this->pbump(static_cast<std::size_t>(
 							-pending));
 			}
@@ -330,112 +849,593 @@ namespace swoope {
 		return result;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	void
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	init_io()
 	{
 		char_type *gbase, *pbase;
 
-		if (this->base == 0)
-			this->setbuf(0, BUFSIZ);
+		if (this->base == 0) {
+			/* A released buffer comes back with the sizes it had */
+			if (BufferPolicy::is_inline != false)
+				this->base = own_storage();
+			else if (this->gasize == 0)
+				this->setbuf(0, BUFSIZ);
+			else if (resize(this->gasize, this->pasize) == false)
+				this->setbuf(0, 1);
+		}
 		gbase = this->base;
-		pbase = gbase + this->gasize;
+		pbase = gbase + get_area_size();
 		if ((this->mode & std::ios_base::in) != 0)
 			this->setg(gbase, gbase, gbase);
 		if ((this->mode & std::ios_base::out) != 0)
-			this->setp(pbase, pbase + this->pasize);
+			this->setp(pbase, pbase + put_area_size());
+	}
+
+	/*
+	 * Returns true if idle release is on, the buffer is owned, no input or
+	 * output is buffered, and the last read did not fill the get area,
+	 * which would suggest that more input is queued.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	idle() const
+	{
+		if (this->idle_release == false) return false;
+		if (this->base == 0 || this->auto_delete_base == false)
+			return false;
+		if (this->gptr() != this->egptr() || this->gafull != false)
+			return false;
+		return this->pptr() == this->pbase();
+	}
+
+	/* Gives the buffer back if the socketbuf is idle */
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	release_idle()
+	{
+		if (idle() == false) return;
+		this->setg(0, 0, 0);
+		this->setp(0, 0);
+		this->reset_base(0, false);
+	}
+
+	/*
+	 * Reads input that is already queued into the get area of an idle
+	 * socketbuf, so that a busy socket keeps its buffer, or gives the
+	 * buffer back if none is. Returns the number of bytes read, 0 at end
+	 * of stream, or -1 if the caller should wait for input as usual.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	read_queued()
+	{
+		std::streamsize got;
+
+		if (this->gptr() == 0 || idle() == false) return -1;
+		this->blocked = false;
+		got = socket_traits_type::try_read(socket(), this->eback(),
+							get_area_size());
+		if (got < 0) release_idle();
+		return got;
+	}
+
+	/*
+	 * Waits for input while the buffer is released, so that an idle socket
+	 * blocks, or reports that it would block, without holding one. Returns
+	 * false if there is no input to read.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	wait_input()
+	{
+		int ready;
+
+		if (this->idle_release == false || this->base != 0) return true;
+		this->blocked = false;
+		do {
+			ready = socket_traits_type::peek(socket());
+		} while (ready < 0 && retry(std::ios_base::in) != false);
+		if (ready < 0)
+			this->blocked = socket_traits_type::would_block();
+		return ready > 0;
+	}
+
+	/*
+	 * Decides whether a sync() defers the pending output. With
+	 * flush_coalesce, the first deferred sync corks the socket and starts
+	 * the coalescing delay, and output is not deferred if the socket
+	 * cannot be corked.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	defer_flush()
+	{
+		long now;
+
+		if (this->flush_mode == flush_immediate) return false;
+		if (this->flush_mode == flush_explicit) return true;
+		now = socket_traits_type::monotonic_time();
+		if (this->flush_since == -1) {
+			if (socket_traits_type::set_cork(socket(), true) != 0)
+				return false;
+			this->flush_since = now;
+		}
+		/* The clock counts milliseconds, so the delay rounds up */
+		return now - this->flush_since < this->flush_delay / 1000 +
+					(this->flush_delay % 1000 != 0 ? 1 : 0);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	timed() const
+	{
+		return this->read_timeout >= 0 || this->write_timeout >= 0;
+	}
+
+	/* Starts an operation, whose time limit runs from its first wait */
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	arm()
+	{
+		this->deadline = -1;
+		this->expired = false;
 	}
 
-	template <class SocketTraits>
+	/*
+	 * Waits after a call that would have blocked, when the socket is
+	 * non-blocking only to keep time limits. Returns true if the call
+	 * should be retried, or false if it should fail, setting expired if
+	 * the time limit passed.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	retry(std::ios_base::openmode which)
+	{
+		long timeout((which == std::ios_base::in) ?
+				this->read_timeout : this->write_timeout);
+		socket_type s(socket());
+		std::ios_base::openmode ready;
+		long left;
+		int wait, result;
+
+		if (this->nonblocking != false || timed() == false ||
+				socket_traits_type::would_block() == false)
+			return false;
+		if (this->deadline == -1 && timeout >= 0)
+			this->deadline = socket_traits_type::monotonic_time() +
+									timeout;
+		for (;;) {
+			wait = -1;
+			if (timeout >= 0) {
+				left = this->deadline -
+					socket_traits_type::monotonic_time();
+				if (left <= 0) {
+					this->expired = true;
+					return false;
+				}
+				wait = static_cast<int>(left);
+			}
+			result = socket_traits_type::poll(&s, &which, &ready, 1,
+									wait);
+			if (result != 0) return result > 0;
+		}
+	}
+
+	template <class SocketTraits, class BufferPolicy>
 	std::streamsize
-	basic_socketbuf<SocketTraits>::
+	basic_socketbuf<SocketTraits, BufferPolicy>::
 	read(char_type* s, std::streamsize n)
 	{
 		std::streamsize got, result(0);
 
-		got = socket_traits_type::read(this->__socketbuf_base_type::
-								socket, s, n);
-		if (got > 0) result = got;
+		this->blocked = false;
+		do {
+			got = socket_traits_type::read(socket(), s, n);
+		} while (got < 0 && retry(std::ios_base::in) != false);
+		if (got > 0)
+			result = got;
+		else if (got < 0)
+			this->blocked = socket_traits_type::would_block();
 		return result;
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	std::streamsize
-	basic_socketbuf<SocketTraits>::
-	write(const char_type* s, std::streamsize n)
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	read(char_type* s1, std::streamsize n1, char_type* s2,
+						std::streamsize n2)
+	{
+		std::streamsize got, result(0);
+
+		this->blocked = false;
+		do {
+			got = socket_traits_type::read(socket(), s1, n1, s2,
+									n2);
+		} while (got < 0 && retry(std::ios_base::in) != false);
+		if (got > 0)
+			result = got;
+		else if (got < 0)
+			this->blocked = socket_traits_type::would_block();
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	read_all(char_type* s, std::streamsize n)
+	{
+		std::streamsize got, result(0);
+
+		/*
+		 * A socket with time limits is non-blocking underneath, so the
+		 * receive-all may stop early and is resumed after poll.
+		 */
+		while (result < n) {
+			got = socket_traits_type::read_all(socket(), s + result,
+								n - result);
+			if (got > 0)
+				result += got;
+			else if (got == 0 || retry(std::ios_base::in) == false)
+				break;
+			if (timed() == false) break;
+		}
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	write(const char_type* s, std::streamsize n, bool more)
 	{
 		std::streamsize put, result(0);
 
+		this->blocked = false;
 		while (result < n) {
-			put = socket_traits_type::write(
-						this->__socketbuf_base_type::
-							socket, s, n - result);
-			if (put < 0) break;
+			if (more != false)
+				put = socket_traits_type::write_more(socket(), s,
+								n - result);
+			else
+				put = socket_traits_type::write(socket(), s,
+								n - result);
+			if (put < 0 && retry(std::ios_base::out) != false)
+				continue;
+			if (put < 0) {
+				this->blocked = socket_traits_type::
+							would_block();
+				break;
+			}
 			s += put;
 			result += put;
 		}
 		return result;
 	}
 
-	template <class SocketTraits>
-	basic_socketbuf_base<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	write(const char_type* s1, std::streamsize n1,
+				const char_type* s2, std::streamsize n2, bool more)
+	{
+		std::streamsize put, result(0);
+
+		this->blocked = false;
+		while (result < n1) {
+			if (more != false)
+				put = socket_traits_type::write_more(socket(),
+					s1 + result, n1 - result, s2, n2);
+			else
+				put = socket_traits_type::write(socket(),
+					s1 + result, n1 - result, s2, n2);
+			if (put < 0 && retry(std::ios_base::out) != false)
+				continue;
+			if (put < 0) {
+				this->blocked = socket_traits_type::
+							would_block();
+				return result;
+			}
+			result += put;
+		}
+		return result + write(s2 + (result - n1), n2 - (result - n1),
+									more);
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	write_zerocopy(const char_type* s, std::streamsize n)
+	{
+		std::streamsize put, result(0);
+
+		this->blocked = false;
+		while (result < n) {
+			put = socket_traits_type::write_zerocopy(
+					this->__socketbuf_base_type::socket,
+					s + result, n - result);
+			if (put < 0 && retry(std::ios_base::out) != false)
+				continue;
+			if (put < 0) {
+				this->blocked = socket_traits_type::
+							would_block();
+				/*
+				 * The kernel may refuse to pin more pages, so
+				 * anything but a full socket falls back to copying.
+				 */
+				if (this->blocked == false)
+					result += write(s + result, n - result);
+				break;
+			}
+			++this->zerocopy_sent;
+			result += put;
+		}
+		if (this->zerocopy_wait != false) zerocopy_flush();
+		return result;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	zerocopy_record(unsigned first, unsigned last)
+	{
+		std::map<unsigned, unsigned>::iterator i;
+
+		this->zerocopy_early[first] = last;
+		while ((i = this->zerocopy_early.find(this->zerocopy_done)) !=
+					this->zerocopy_early.end()) {
+			this->zerocopy_done = i->second + 1;
+			this->zerocopy_early.erase(i);
+		}
+	}
+
+	/*
+	 * Moves the get and put areas into a new buffer of the given sizes,
+	 * keeping unread input and pending output, which must fit.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	resize(std::streamsize gsize, std::streamsize psize)
+	{
+		std::streamsize unread(0), pending(0);
+		bool gio(this->gptr() != 0), pio(this->pptr() != 0);
+		char_type* p;
+
+		if (BufferPolicy::is_inline != false) return false;
+		if (gio != false) unread = this->egptr() - this->gptr();
+		if (pio != false) pending = this->pptr() - this->pbase();
+		if (unread > gsize || pending > psize) return false;
+		p = this->allocate_base(static_cast<std::size_t>(gsize +
+								psize));
+		if (p == 0) return false;
+		if (gio != false)
+			std::copy(this->gptr(), this->egptr(), p);
+		if (pio != false)
+			std::copy(this->pbase(), this->pptr(), p + gsize);
+		this->reset_base(p, true, static_cast<std::size_t>(gsize +
+								psize));
+		this->gasize = gsize;
+		this->pasize = psize;
+		if (gio != false)
+			this->setg(p, p, p + unread);
+		if (pio != false) {
+			this->setp(p + gsize, p + gsize + psize);
+			this->pbump(static_cast<std::size_t>(pending));
+		}
+		return true;
+	}
+
+	/*
+	 * The area sizes are compile-time constants for inline buffers, which
+	 * lets the copy paths be specialized for them.
+	 */
+	template <class SocketTraits, class BufferPolicy>
+	inline std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	get_area_size() const
+	{
+		if (BufferPolicy::is_inline != false)
+			return static_cast<std::streamsize>(BufferPolicy::get_size);
+		return this->gasize;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	inline std::streamsize
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	put_area_size() const
+	{
+		if (BufferPolicy::is_inline != false)
+			return static_cast<std::streamsize>(BufferPolicy::put_size);
+		return this->pasize;
+	}
+
+	/* Returns the storage inside this object that base may point to */
+	template <class SocketTraits, class BufferPolicy>
+	typename basic_socketbuf<SocketTraits, BufferPolicy>::char_type*
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	own_storage()
+	{
+		if (BufferPolicy::is_inline != false) return this->data();
+		return &this->buf[0];
+	}
+
+	/* Moves base and the get and put areas from buffer from to buffer to */
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	relocate(char_type* from, char_type* to)
+	{
+		std::streamsize pending;
+
+		this->base = to;
+		if (this->eback() != 0)
+			this->setg(to + (this->eback() - from),
+					to + (this->gptr() - from),
+					to + (this->egptr() - from));
+		if (this->pbase() != 0) {
+			pending = this->pptr() - this->pbase();
+			this->setp(to + (this->pbase() - from),
+					to + (this->epptr() - from));
+			this->pbump(static_cast<std::size_t>(pending));
+		}
+	}
+
+	/* Returns true if the last send left output in the put area */
+	template <class SocketTraits, class BufferPolicy>
+	bool
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	retained() const
+	{
+		return this->blocked != false && this->pptr() != this->pbase();
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	void
+	basic_socketbuf<SocketTraits, BufferPolicy>::
+	retain(std::streamsize sent)
+	{
+		char_type* p((std::copy(this->pbase() + sent, this->pptr(),
+							this->pbase())));
+
+		this->setp(this->pbase(), this->epptr());
+		this->pbump(static_cast<std::size_t>(p - this->pbase()));
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
 	basic_socketbuf_base() :
 	socket(SocketTraits::invalid()),
+	local_ep(),
+	remote_ep(),
+	local_known(false),
+	remote_known(false),
 	buf(),
-	base(0),
-	gasize(0),
-	pasize(0),
+	base(BufferPolicy::data()),
+	gasize(static_cast<std::streamsize>(BufferPolicy::get_size)),
+	pasize(static_cast<std::streamsize>(BufferPolicy::put_size)),
+	gamax(0),
+	gafull(false),
 	mode(),
 	is_open(false),
-	auto_delete_base(false)
+	auto_delete_base(false),
+	allocator(0),
+	base_allocator(0),
+	base_size(0),
+	idle_release(false),
+	preset_options(),
+	flush_mode(flush_immediate),
+	flush_delay(0),
+	flush_since(-1),
+	connect_timeout(-1),
+	read_timeout(-1),
+	write_timeout(-1),
+	deadline(-1),
+	expired(false),
+	nonblocking(false),
+	blocked(false),
+	zerocopy_threshold(0),
+	zerocopy_wait(true),
+	zerocopy_sent(0),
+	zerocopy_done(0),
+	zerocopy_early()
 	{
 	}
 	
-	template <class SocketTraits>
-	basic_socketbuf_base<SocketTraits>::
+	template <class SocketTraits, class BufferPolicy>
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
 	~basic_socketbuf_base()
 	{
 		reset_base(0, false);
 	}
 
 #if __cplusplus >= 201103L
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	void
-	basic_socketbuf_base<SocketTraits>::
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
 	swap(basic_socketbuf_base& rhs)
 	{
 		using std::swap;
+		BufferPolicy::swap(rhs);
 		swap(socket, rhs.socket);
+		swap(local_ep, rhs.local_ep);
+		swap(remote_ep, rhs.remote_ep);
+		swap(local_known, rhs.local_known);
+		swap(remote_known, rhs.remote_known);
 		swap(buf, rhs.buf);
 		swap(base, rhs.base);
 		swap(gasize, rhs.gasize);
 		swap(pasize, rhs.pasize);
+		swap(gamax, rhs.gamax);
+		swap(gafull, rhs.gafull);
 		swap(mode, rhs.mode);
 		swap(is_open, rhs.is_open);
 		swap(auto_delete_base, rhs.auto_delete_base);
+		swap(allocator, rhs.allocator);
+		swap(base_allocator, rhs.base_allocator);
+		swap(base_size, rhs.base_size);
+		swap(idle_release, rhs.idle_release);
+		swap(preset_options, rhs.preset_options);
+		swap(flush_mode, rhs.flush_mode);
+		swap(flush_delay, rhs.flush_delay);
+		swap(flush_since, rhs.flush_since);
+		swap(connect_timeout, rhs.connect_timeout);
+		swap(read_timeout, rhs.read_timeout);
+		swap(write_timeout, rhs.write_timeout);
+		swap(deadline, rhs.deadline);
+		swap(expired, rhs.expired);
+		swap(nonblocking, rhs.nonblocking);
+		swap(blocked, rhs.blocked);
+		swap(zerocopy_threshold, rhs.zerocopy_threshold);
+		swap(zerocopy_wait, rhs.zerocopy_wait);
+		swap(zerocopy_sent, rhs.zerocopy_sent);
+		swap(zerocopy_done, rhs.zerocopy_done);
+		swap(zerocopy_early, rhs.zerocopy_early);
 	}
 #endif
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	void
-	basic_socketbuf_base<SocketTraits>::
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
 	release_base()
 	{
 		base = 0;
 		auto_delete_base = false;
+		base_allocator = 0;
+		base_size = 0;
+	}
+
+	template <class SocketTraits, class BufferPolicy>
+	char*
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
+	allocate_base(std::size_t n)
+	{
+		if (allocator != 0) return allocator->allocate(n);
+		return new char[n];
 	}
 
-	template <class SocketTraits>
+	template <class SocketTraits, class BufferPolicy>
 	void
-	basic_socketbuf_base<SocketTraits>::
-	reset_base(char* p, bool auto_delete)
+	basic_socketbuf_base<SocketTraits, BufferPolicy>::
+	reset_base(char* p, bool auto_delete, std::size_t n)
 	{
 		if (base != 0 && auto_delete_base == true) {
-			delete[] base;
+			if (base_allocator != 0)
+				base_allocator->deallocate(base, base_size);
+			else
+				delete[] base;
 		}
 		base = p;
 		auto_delete_base = auto_delete;
+		base_allocator = (auto_delete != false) ? allocator : 0;
+		base_size = n;
 	}
 
 }
@@ -0,0 +1,48 @@
+#ifndef SWOOPE_LISTENER_OPTIONS_HH
+#define SWOOPE_LISTENER_OPTIONS_HH
+
+/*
+ * listener_options.hh
+ */
+
+#include "socket_option.hh"
+#include <vector>
+
+namespace swoope {
+
+	/* Settings applied to a listening socket before it is bound */
+	struct listener_options {
+		/*
+		 * Set SO_REUSEPORT so that several listeners can bind the same
+		 * port and the kernel spreads incoming connections over them
+		 */
+		bool reuse_port;
+
+		/*
+		 * CPU whose connections this listener prefers through
+		 * SO_INCOMING_CPU, or -1 to leave it unset (Linux only)
+		 */
+		int incoming_cpu;
+
+		/*
+		 * Attach a reuseport program that hands each connection to the
+		 * listener whose index in the group equals the CPU that received
+		 * it, so listener i should be served from CPU i (Linux only)
+		 */
+		bool steer_by_cpu;
+
+		/* Options set on the socket before it listens */
+		std::vector<socket_option> socket_options;
+
+		listener_options() :
+		reuse_port(false),
+		incoming_cpu(-1),
+		steer_by_cpu(false),
+		socket_options()
+		{
+		}
+	};
+
+}
+
+#endif
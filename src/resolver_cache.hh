@@ -0,0 +1,230 @@
+#ifndef SWOOPE_RESOLVER_CACHE_HH
+#define SWOOPE_RESOLVER_CACHE_HH
+
+/*
+ * resolver_cache.hh
+ */
+
+#if defined(__WINDOWS__) || \
+	defined(_WIN32) || \
+	defined(__WIN32__)
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+namespace swoope {
+
+	/*
+	 * Thread-safe cache of getaddrinfo results, keyed by host, service,
+	 * address family and socket type. Successful lookups are kept for
+	 * lifetime and failed ones for negative_lifetime. With background refresh, an
+	 * entry that is used shortly before it expires is looked up again by
+	 * a worker thread, and an expired entry is still returned
+	 * while its refresh is pending, so that callers never wait on the
+	 * resolver for a name they have seen before.
+	 */
+	class resolver_cache {
+	public:
+		typedef std::shared_ptr<const addrinfo> result_type;
+		typedef std::chrono::steady_clock clock_type;
+
+		explicit resolver_cache(
+			clock_type::duration lifetime = std::chrono::seconds(30),
+			clock_type::duration negative_lifetime =
+						std::chrono::seconds(5),
+			bool background_refresh = false) :
+		ttl(lifetime),
+		negative_ttl(negative_lifetime),
+		refresh(background_refresh),
+		stopping(false),
+		entries(),
+		queue(),
+		lock(),
+		wake(),
+		worker()
+		{
+			if (refresh != false)
+				worker = std::thread(&resolver_cache::run, this);
+		}
+
+		~resolver_cache()
+		{
+			{
+				std::lock_guard<std::mutex> g(lock);
+				stopping = true;
+			}
+			wake.notify_one();
+			if (worker.joinable()) worker.join();
+		}
+
+		/*
+		 * Returns the addresses of host and service, from the cache if
+		 * possible. Returns an empty pointer if the name does not
+		 * resolve. The list stays valid while the pointer is held.
+		 */
+		result_type resolve(const std::string& host,
+					const std::string& service,
+					int family = AF_UNSPEC,
+					int socktype = SOCK_STREAM)
+		{
+			key_type key(host, service, family, socktype);
+			clock_type::time_point now(clock_type::now());
+			std::unique_lock<std::mutex> g(lock);
+			entry_map::iterator i(entries.find(key));
+			result_type result;
+			int error;
+
+			if (i != entries.end()) {
+				entry& e(i->second);
+
+				if (now < e.expires) {
+					if (refresh != false && e.queued == false &&
+						e.addresses && now >= e.refresh_at)
+						enqueue(key, e);
+					return e.addresses;
+				}
+				if (refresh != false && e.addresses) {
+					if (e.queued == false) enqueue(key, e);
+					return e.addresses;
+				}
+			}
+			g.unlock();
+			result = lookup(key, &error);
+			/* A temporary failure is not worth remembering */
+			if (!result && error == EAI_AGAIN) return result;
+			return store(key, result);
+		}
+
+		/* Drops every entry. */
+		void clear()
+		{
+			std::lock_guard<std::mutex> g(lock);
+
+			entries.clear();
+		}
+
+		/* Returns the number of cached names, failed ones included. */
+		std::size_t size() const
+		{
+			std::lock_guard<std::mutex> g(lock);
+
+			return entries.size();
+		}
+	private:
+		typedef std::tuple<std::string, std::string, int, int>
+								key_type;
+
+		struct entry {
+			result_type addresses;
+			clock_type::time_point expires, refresh_at;
+			bool queued;
+		};
+
+		typedef std::map<key_type, entry> entry_map;
+
+		resolver_cache(const resolver_cache&) = delete;
+		resolver_cache& operator=(const resolver_cache&) = delete;
+
+		/* Returns the result of getaddrinfo, empty if it failed with error */
+		static result_type lookup(const key_type& key, int* error)
+		{
+			addrinfo *ai, hints = addrinfo();
+			int result;
+
+			hints.ai_family = std::get<2>(key);
+			hints.ai_socktype = std::get<3>(key);
+			result = ::getaddrinfo(std::get<0>(key).c_str(),
+					std::get<1>(key).c_str(), &hints, &ai);
+			*error = result;
+			if (result != 0) return result_type();
+			return result_type(ai, ::freeaddrinfo);
+		}
+
+		result_type store(const key_type& key, const result_type& r)
+		{
+			clock_type::time_point now(clock_type::now());
+			std::lock_guard<std::mutex> g(lock);
+			entry& e(entries[key]);
+
+			e.addresses = r;
+			if (r) {
+				e.expires = now + ttl;
+				/* Refresh once three quarters of ttl have passed */
+				e.refresh_at = now + ttl * 3 / 4;
+			} else {
+				e.expires = now + negative_ttl;
+				e.refresh_at = e.expires;
+			}
+			e.queued = false;
+			return r;
+		}
+
+		void enqueue(const key_type& key, entry& e)
+		{
+			e.queued = true;
+			queue.push_back(key);
+			wake.notify_one();
+		}
+
+		/* Refreshes queued names until the cache is destroyed */
+		void run()
+		{
+			std::unique_lock<std::mutex> g(lock);
+			key_type key;
+			result_type r;
+			int error;
+
+			for (;;) {
+				wake.wait(g, [this] {
+					return stopping != false ||
+						queue.empty() == false;
+				});
+				if (stopping != false) return;
+				key = queue.front();
+				queue.pop_front();
+				g.unlock();
+				r = lookup(key, &error);
+				g.lock();
+				entry_map::iterator i(entries.find(key));
+				if (i == entries.end()) continue;
+				/*
+				 * A resolver that is temporarily unavailable keeps
+				 * the old addresses in service.
+				 */
+				if (!r && error == EAI_AGAIN) {
+					i->second.queued = false;
+					continue;
+				}
+				g.unlock();
+				store(key, r);
+				g.lock();
+			}
+		}
+
+		const clock_type::duration ttl, negative_ttl;
+		const bool refresh;
+		bool stopping;
+		entry_map entries;
+		std::deque<key_type> queue;
+		mutable std::mutex lock;
+		std::condition_variable wake;
+		std::thread worker;
+	};
+
+}
+
+#endif
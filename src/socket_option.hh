@@ -0,0 +1,91 @@
+#ifndef SWOOPE_SOCKET_OPTION_HH
+#define SWOOPE_SOCKET_OPTION_HH
+
+/*
+ * socket_option.hh
+ */
+
+namespace swoope {
+
+	/*
+	 * A socket option and its value. The socket traits map the name to
+	 * the system's level and option, and fail with ENOPROTOOPT where the
+	 * system has no such option.
+	 */
+	struct socket_option {
+		enum name_type {
+			nodelay, /* TCP_NODELAY */
+			quickack, /* TCP_QUICKACK (Linux) */
+			send_buffer, /* SO_SNDBUF, bytes */
+			receive_buffer, /* SO_RCVBUF, bytes */
+			priority, /* SO_PRIORITY (Linux) */
+			user_timeout, /* TCP_USER_TIMEOUT, milliseconds (Linux) */
+			keepalive, /* SO_KEEPALIVE */
+			keepalive_idle, /* TCP_KEEPIDLE or TCP_KEEPALIVE, seconds */
+			keepalive_interval, /* TCP_KEEPINTVL, seconds */
+			keepalive_count /* TCP_KEEPCNT */
+		};
+
+		name_type name;
+		int value;
+
+		socket_option(name_type n, int v) :
+		name(n),
+		value(v)
+		{
+		}
+	};
+
+	inline socket_option tcp_nodelay(bool on)
+	{
+		return socket_option(socket_option::nodelay, on);
+	}
+
+	inline socket_option tcp_quickack(bool on)
+	{
+		return socket_option(socket_option::quickack, on);
+	}
+
+	inline socket_option send_buffer_size(int bytes)
+	{
+		return socket_option(socket_option::send_buffer, bytes);
+	}
+
+	inline socket_option receive_buffer_size(int bytes)
+	{
+		return socket_option(socket_option::receive_buffer, bytes);
+	}
+
+	inline socket_option socket_priority(int priority)
+	{
+		return socket_option(socket_option::priority, priority);
+	}
+
+	inline socket_option tcp_user_timeout(int milliseconds)
+	{
+		return socket_option(socket_option::user_timeout, milliseconds);
+	}
+
+	inline socket_option tcp_keepalive(bool on)
+	{
+		return socket_option(socket_option::keepalive, on);
+	}
+
+	inline socket_option tcp_keepalive_idle(int seconds)
+	{
+		return socket_option(socket_option::keepalive_idle, seconds);
+	}
+
+	inline socket_option tcp_keepalive_interval(int seconds)
+	{
+		return socket_option(socket_option::keepalive_interval, seconds);
+	}
+
+	inline socket_option tcp_keepalive_count(int probes)
+	{
+		return socket_option(socket_option::keepalive_count, probes);
+	}
+
+}
+
+#endif
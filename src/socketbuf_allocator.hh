@@ -0,0 +1,31 @@
+#ifndef SWOOPE_SOCKETBUF_ALLOCATOR_HH
+#define SWOOPE_SOCKETBUF_ALLOCATOR_HH
+
+/*
+ * socketbuf_allocator.hh
+ */
+
+#include <cstddef>
+
+namespace swoope {
+
+	/*
+	 * Supplies the buffers that hold the get and put areas of a
+	 * basic_socketbuf.
+	 */
+	class socketbuf_allocator {
+	public:
+		virtual ~socketbuf_allocator() {}
+		/*
+		 * Returns a buffer of at least n bytes, or 0 if none can be
+		 * supplied, in which case the socketbuf falls back to unbuffered
+		 * I/O.
+		 */
+		virtual char* allocate(std::size_t n) = 0;
+		/* Takes back buffer p, which allocate(n) returned. */
+		virtual void deallocate(char* p, std::size_t n) = 0;
+	};
+
+}
+
+#endif
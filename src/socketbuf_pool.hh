@@ -0,0 +1,247 @@
+#ifndef SWOOPE_SOCKETBUF_POOL_HH
+#define SWOOPE_SOCKETBUF_POOL_HH
+
+/*
+ * socketbuf_pool.hh
+ */
+
+#include "socketbuf_allocator.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace swoope {
+
+	/*
+	 * Byte limit that several pools, for example one per thread, draw
+	 * from together.
+	 */
+	class socketbuf_budget {
+	public:
+		explicit socketbuf_budget(std::size_t limit) :
+		max(limit),
+		used(0)
+		{
+		}
+
+		/* Reserves n bytes. Returns false if that would exceed the limit. */
+		bool acquire(std::size_t n)
+		{
+			std::size_t cur(used.load(std::memory_order_relaxed));
+
+			do {
+				if (n > max || cur > max - n) return false;
+			} while (used.compare_exchange_weak(cur, cur + n,
+						std::memory_order_relaxed) == false);
+			return true;
+		}
+
+		void release(std::size_t n)
+		{
+			used.fetch_sub(n, std::memory_order_relaxed);
+		}
+
+		std::size_t limit() const
+		{
+			return max;
+		}
+
+		std::size_t in_use() const
+		{
+			return used.load(std::memory_order_relaxed);
+		}
+	private:
+		socketbuf_budget(const socketbuf_budget&) = delete;
+		socketbuf_budget& operator=(const socketbuf_budget&) = delete;
+
+		const std::size_t max;
+		std::atomic<std::size_t> used;
+	};
+
+	/*
+	 * Slab allocator of fixed-size socketbuf buffers. A pool is not
+	 * synchronized, so each thread or reactor should own one and hand it
+	 * to the socketbufs it serves with set_allocator.
+	 */
+	class socketbuf_pool : public socketbuf_allocator {
+	public:
+		enum {
+			/*
+			 * Back slabs with huge pages where the system has them.
+			 * Takes effect when a slab is a multiple of the huge page
+			 * size.
+			 */
+			huge_pages = 1,
+			/*
+			 * Touch every new slab from the allocating thread so that
+			 * first-touch placement puts it on that thread's NUMA node
+			 */
+			numa_local = 2
+		};
+
+		struct stats_type {
+			std::size_t
+				block_size, /* bytes per block */
+				slabs, /* slabs allocated */
+				blocks, /* blocks in all slabs */
+				blocks_in_use, /* blocks handed out */
+				bytes_reserved, /* slab and oversize bytes held */
+				peak_bytes_reserved, /* highest bytes_reserved */
+				failures; /* requests refused by the budget */
+		};
+
+		/*
+		 * Creates a pool handing out blocks of block_size bytes, carved
+		 * from slabs of blocks_per_slab blocks. Requests larger than a
+		 * block are served from the heap. Every byte the pool reserves is
+		 * drawn from shared_budget if one is given.
+		 */
+		explicit socketbuf_pool(std::size_t block_size = BUFSIZ,
+					std::size_t blocks_per_slab = 64,
+					socketbuf_budget* shared_budget = 0,
+					int pool_flags = 0) :
+		block(block_size < sizeof(void*) ? sizeof(void*) :
+							block_size),
+		per_slab(blocks_per_slab < 1 ? 1 : blocks_per_slab),
+		budget(shared_budget),
+		flags(pool_flags),
+		free_list(0),
+		slabs(),
+		st()
+		{
+			st.block_size = block;
+		}
+
+		/* Releases every slab. No buffer of the pool may still be in use. */
+		~socketbuf_pool()
+		{
+			for (std::size_t i = 0; i < slabs.size(); ++i)
+				free_slab(slabs[i].first, slabs[i].second);
+		}
+
+		char* allocate(std::size_t n)
+		{
+			char* result;
+
+			if (n > block) {
+				if (reserve(n) == false) return 0;
+				result = new (std::nothrow) char[n];
+				if (result == 0) unreserve(n);
+				return result;
+			}
+			if (free_list == 0 && grow() == false) return 0;
+			result = free_list;
+			std::memcpy(&free_list, result, sizeof(free_list));
+			++st.blocks_in_use;
+			return result;
+		}
+
+		void deallocate(char* p, std::size_t n)
+		{
+			if (p == 0) return;
+			if (n > block) {
+				delete[] p;
+				unreserve(n);
+				return;
+			}
+			std::memcpy(p, &free_list, sizeof(free_list));
+			free_list = p;
+			--st.blocks_in_use;
+		}
+
+		stats_type stats() const
+		{
+			return st;
+		}
+	private:
+		socketbuf_pool(const socketbuf_pool&) = delete;
+		socketbuf_pool& operator=(const socketbuf_pool&) = delete;
+
+		bool reserve(std::size_t n)
+		{
+			if (budget != 0 && budget->acquire(n) == false) {
+				++st.failures;
+				return false;
+			}
+			st.bytes_reserved += n;
+			if (st.bytes_reserved > st.peak_bytes_reserved)
+				st.peak_bytes_reserved = st.bytes_reserved;
+			return true;
+		}
+
+		void unreserve(std::size_t n)
+		{
+			if (budget != 0) budget->release(n);
+			st.bytes_reserved -= n;
+		}
+
+		/* Adds a slab and threads its blocks onto the free list */
+		bool grow()
+		{
+			std::size_t size(block * per_slab);
+			char* slab;
+
+			if (reserve(size) == false) return false;
+			if ((slab = alloc_slab(size)) == 0) {
+				unreserve(size);
+				return false;
+			}
+			if ((flags & numa_local) != 0)
+				std::memset(slab, 0, size);
+			slabs.push_back(std::make_pair(slab, size));
+			for (std::size_t i = per_slab; i > 0; --i) {
+				char* p(slab + (i - 1) * block);
+				std::memcpy(p, &free_list, sizeof(free_list));
+				free_list = p;
+			}
+			++st.slabs;
+			st.blocks += per_slab;
+			return true;
+		}
+
+		char* alloc_slab(std::size_t size)
+		{
+#if defined(__linux__)
+			void* p(MAP_FAILED);
+
+			if ((flags & huge_pages) != 0)
+				p = ::mmap(0, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS |
+					MAP_HUGETLB, -1, 0);
+			if (p == MAP_FAILED)
+				p = ::mmap(0, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return (p == MAP_FAILED) ? 0 : static_cast<char*>(p);
+#else
+			return new (std::nothrow) char[size];
+#endif
+		}
+
+		void free_slab(char* slab, std::size_t size)
+		{
+#if defined(__linux__)
+			::munmap(slab, size);
+#else
+			delete[] slab;
+#endif
+			unreserve(size);
+		}
+
+		const std::size_t block, per_slab;
+		socketbuf_budget* const budget;
+		const int flags;
+		char* free_list;
+		std::vector<std::pair<char*, std::size_t> > slabs;
+		stats_type st;
+	};
+
+}
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef SWOOPE_TIMING_WHEEL_HH
+#define SWOOPE_TIMING_WHEEL_HH
+
+/*
+ * timing_wheel.hh
+ */
+
+#include <cstddef>
+
+namespace swoope {
+
+	/*
+	 * Hierarchical timing wheel: four levels of 256 slots, each slot a
+	 * list of timers. Scheduling, rescheduling and cancelling a timer take
+	 * constant time, and timers due in the same tick expire together. The
+	 * wheel keeps no clock of its own; it moves forward when advance() is
+	 * called, so that any event loop can drive it from a monotonic clock.
+	 * A wheel is not synchronized.
+	 */
+	class timing_wheel {
+	public:
+		typedef unsigned long tick_type;
+
+		/*
+		 * Base class of anything that can be scheduled, for example a
+		 * member of a connection object that closes it when idle.
+		 */
+		class timer {
+		public:
+			timer() :
+			prev(0),
+			next(0),
+			owner(0),
+			when(0)
+			{
+			}
+
+			/* A timer is cancelled when it is destroyed. */
+			virtual ~timer()
+			{
+				cancel();
+			}
+
+			/*
+			 * Called by advance() once the timer is due, after it has
+			 * been taken off the wheel. May schedule this or any other
+			 * timer again, cancel timers, or destroy this timer.
+			 */
+			virtual void expire() = 0;
+
+			bool armed() const
+			{
+				return owner != 0;
+			}
+
+			/* Tick at which an armed timer is due. */
+			tick_type due() const
+			{
+				return when;
+			}
+
+			void cancel()
+			{
+				if (owner != 0) owner->cancel(*this);
+			}
+		private:
+			friend class timing_wheel;
+
+			timer(const timer&);
+			timer& operator=(const timer&);
+
+			timer *prev, *next;
+			timing_wheel* owner;
+			tick_type when;
+		};
+
+		enum {
+			slot_bits = 8,
+			slots = 1 << slot_bits,
+			levels = 4
+		};
+
+		/* Longest delay schedule() accepts, in ticks */
+		static tick_type max_delay()
+		{
+			return (1UL << (slot_bits * (levels - 1))) *
+							(slots - 1) - 1;
+		}
+
+		/* Creates a wheel whose current tick is start. */
+		explicit timing_wheel(tick_type start = 0) :
+		current(start),
+		count(0)
+		{
+			for (int l = 0; l < levels; ++l)
+				for (int s = 0; s < slots; ++s)
+					clear(wheel[l][s]);
+		}
+
+		/* Disarms the remaining timers without expiring them. */
+		~timing_wheel()
+		{
+			for (int l = 0; l < levels; ++l)
+				for (int s = 0; s < slots; ++s)
+					while (wheel[l][s].next != &wheel[l][s])
+						cancel(*wheel[l][s].next);
+		}
+
+		/*
+		 * Arms t to expire delay ticks from now, at least one, and at most
+		 * max_delay(). A timer that is already armed, on this wheel or
+		 * another, is moved.
+		 */
+		void schedule(timer& t, tick_type delay)
+		{
+			if (delay < 1) delay = 1;
+			if (delay > max_delay()) delay = max_delay();
+			t.cancel();
+			t.when = current + delay;
+			t.owner = this;
+			place(t);
+			++count;
+		}
+
+		void cancel(timer& t)
+		{
+			if (t.owner != this) return;
+			unlink(t);
+			t.owner = 0;
+			--count;
+		}
+
+		/*
+		 * Moves the wheel ticks forward and expires every timer that
+		 * became due on the way, in order of due tick. Returns the number
+		 * of timers expired.
+		 */
+		std::size_t advance(tick_type ticks)
+		{
+			std::size_t result(0);
+
+			while (ticks-- != 0) {
+				if (count == 0) {
+					current += ticks + 1;
+					break;
+				}
+				++current;
+				cascade(1);
+				result += expire(wheel[0][current & (slots - 1)]);
+			}
+			return result;
+		}
+
+		/* Returns the current tick. */
+		tick_type now() const
+		{
+			return current;
+		}
+
+		/* Returns the number of armed timers. */
+		std::size_t size() const
+		{
+			return count;
+		}
+
+		/*
+		 * Returns how many ticks the wheel can be left alone before a
+		 * timer may be due, or -1 if none is armed. Never more than the
+		 * time to the next cascade, so an event loop can use it as its
+		 * wait timeout.
+		 */
+		long next_timeout() const
+		{
+			tick_type t;
+
+			if (count == 0) return -1;
+			for (t = 1; t < slots; ++t) {
+				const timer& s(wheel[0][(current + t) & (slots - 1)]);
+
+				if (s.next != &s) return static_cast<long>(t);
+				if (((current + t) & (slots - 1)) == 0) break;
+			}
+			return static_cast<long>(t);
+		}
+	private:
+		/* Sentinel heads are timers that never expire */
+		struct head : timer {
+			void expire()
+			{
+			}
+		};
+
+		timing_wheel(const timing_wheel&);
+		timing_wheel& operator=(const timing_wheel&);
+
+		static void clear(timer& h)
+		{
+			h.prev = &h;
+			h.next = &h;
+		}
+
+		static void link(timer& h, timer& t)
+		{
+			t.prev = h.prev;
+			t.next = &h;
+			h.prev->next = &t;
+			h.prev = &t;
+		}
+
+		static void unlink(timer& t)
+		{
+			t.prev->next = t.next;
+			t.next->prev = t.prev;
+			t.prev = 0;
+			t.next = 0;
+		}
+
+		/* Puts t in the slot of the lowest level that reaches its tick */
+		void place(timer& t)
+		{
+			tick_type left(t.when - current);
+			int l(0);
+
+			while (l < levels - 1 &&
+					left >= 1UL << (slot_bits * (l + 1)))
+				++l;
+			link(wheel[l][(t.when >> (slot_bits * l)) & (slots - 1)],
+									t);
+		}
+
+		/*
+		 * When the lower levels wrap around, spreads the next slot of
+		 * level l over the levels below it.
+		 */
+		void cascade(int l)
+		{
+			head pending;
+			timer* t;
+
+			if (l >= levels) return;
+			if ((current & ((1UL << (slot_bits * l)) - 1)) != 0) return;
+			cascade(l + 1);
+			clear(pending);
+			splice(wheel[l][(current >> (slot_bits * l)) &
+							(slots - 1)], pending);
+			while ((t = pending.next) != &pending) {
+				unlink(*t);
+				place(*t);
+			}
+		}
+
+		/* Expires every timer of slot h. Returns how many expired. */
+		std::size_t expire(timer& h)
+		{
+			head batch;
+			timer* t;
+			std::size_t result(0);
+
+			if (h.next == &h) return result;
+			clear(batch);
+			splice(h, batch);
+			while ((t = batch.next) != &batch) {
+				cancel(*t);
+				++result;
+				t->expire();
+			}
+			return result;
+		}
+
+		/* Moves every timer of list from to the empty list to */
+		static void splice(timer& from, timer& to)
+		{
+			if (from.next == &from) return;
+			to.next = from.next;
+			to.prev = from.prev;
+			to.next->prev = &to;
+			to.prev->next = &to;
+			clear(from);
+		}
+
+		head wheel[levels][slots];
+		tick_type current;
+		std::size_t count;
+	};
+
+}
+
+#endif